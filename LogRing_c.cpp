@@ -0,0 +1,352 @@
+/**
+ * @file    LogRing_c.cpp
+ * @author  Phil Lockett <phillockett65@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Shared memory ring buffer Implementation.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "LogRing_c.h"
+
+
+/**
+ * @section shared memory ring buffer implementation.
+ *
+ * Records are laid out as the file name length, the lines length, the file
+ * name then the lines, wrapping around the end of the data area as needed.
+ */
+
+/**
+ * Construct the default ring name for this process.
+ *
+ * @return a new string containing the ring name.
+ */
+std::string LogRing_c::getDefaultName(void)
+{
+    return NAME_PREFIX + std::to_string(getpid());
+}
+
+
+/**
+ * Check if a ring exists, whether or not it is ready.
+ *
+ * @param  ring - the shared memory name of the ring.
+ * @return true if the ring exists, false otherwise.
+ */
+bool LogRing_c::exists(const std::string & ring)
+{
+    const int fd = shm_open(ring.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return errno != ENOENT;
+    }
+    close(fd);
+
+    return true;
+}
+
+
+/**
+ * Create a new ring, owned by this process. Only the owner may write to it.
+ *
+ * @param  ring - the shared memory name of the ring.
+ * @param  bytes - the size of the record data area.
+ * @return true if successful, false otherwise.
+ */
+bool LogRing_c::create(const std::string & ring, size_t bytes)
+{
+    detach();
+
+    const int fd = shm_open(ring.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    const size_t total = sizeof(Header_t) + bytes;
+    if ((ftruncate(fd, total) < 0) || (!map(fd, total)))
+    {
+        close(fd);
+        shm_unlink(ring.c_str());
+
+        return false;
+    }
+    close(fd);
+
+    name = ring;
+    capacity = bytes;
+    uid = geteuid();
+    gid = getegid();
+    header->owner = getpid();
+    header->size = bytes;
+    header->head = 0;
+    header->tail = 0;
+    header->magic.store(MAGIC, std::memory_order_release);
+
+    return true;
+}
+
+
+/**
+ * Attach to an existing ring created by another process. Rings that other
+ * users could write to are rejected. The size of the ring is fixed when
+ * attached, so that changes to the shared header can not move the records
+ * outside of the mapping.
+ *
+ * @param  ring - the shared memory name of the ring.
+ * @return true if successful, false if the ring is missing, not ready or
+ * unsafe.
+ */
+bool LogRing_c::attach(const std::string & ring)
+{
+    detach();
+
+    const int fd = shm_open(ring.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    if ((fstat(fd, &status) < 0) || (status.st_mode & (S_IWGRP | S_IWOTH)) || (static_cast<size_t>(status.st_size) <= sizeof(Header_t)) || (!map(fd, status.st_size)))
+    {
+        close(fd);
+
+        return false;
+    }
+    close(fd);
+
+    name = ring;
+    uid = status.st_uid;
+    gid = status.st_gid;
+    capacity = size - sizeof(Header_t);
+    if ((header->magic.load(std::memory_order_acquire) != MAGIC) || (header->size != capacity))
+    {
+        detach();
+
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Unmap the ring, it remains available to other processes.
+ */
+void LogRing_c::detach(void)
+{
+    if (header)
+    {
+        munmap(header, size);
+    }
+
+    header = nullptr;
+    data = nullptr;
+    size = 0;
+    capacity = 0;
+    corrupt = false;
+}
+
+
+/**
+ * Remove the ring name, processes already attached can continue to use it.
+ *
+ * @return true if successful, false otherwise.
+ */
+bool LogRing_c::remove(void)
+{
+    if (name.empty())
+    {
+        return false;
+    }
+
+    return shm_unlink(name.c_str()) == 0;
+}
+
+
+/**
+ * Get the process that created the ring.
+ *
+ * @return the process ID of the owner, 0 if not attached.
+ */
+pid_t LogRing_c::getOwner(void) const
+{
+    return header ? header->owner : 0;
+}
+
+
+/**
+ * Check if all the records in the ring have been read.
+ *
+ * @return true if the ring is empty or not attached, false otherwise.
+ */
+bool LogRing_c::isEmpty(void) const
+{
+    if (!header)
+    {
+        return true;
+    }
+
+    return header->tail.load(std::memory_order_relaxed) == header->head.load(std::memory_order_acquire);
+}
+
+
+/**
+ * Map the shared memory of the ring.
+ *
+ * @param  fd - the shared memory file descriptor.
+ * @param  bytes - the size of the whole mapping.
+ * @return true if successful, false otherwise.
+ */
+bool LogRing_c::map(int fd, size_t bytes)
+{
+    void * base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        return false;
+    }
+
+    header = static_cast<Header_t *>(base);
+    data = static_cast<char *>(base) + sizeof(Header_t);
+    size = bytes;
+
+    return true;
+}
+
+
+/**
+ * Copy bytes into the data area, wrapping around the end as needed.
+ *
+ * @param  pos - the total bytes position to copy to.
+ * @param  from - the bytes to copy.
+ * @param  length - the number of bytes to copy.
+ */
+void LogRing_c::copyIn(unsigned long long pos, const void * from, size_t length)
+{
+    const size_t offset = pos % capacity;
+    const size_t first = std::min(length, capacity - offset);
+
+    memcpy(data + offset, from, first);
+    memcpy(data, static_cast<const char *>(from) + first, length - first);
+}
+
+
+/**
+ * Copy bytes out of the data area, wrapping around the end as needed.
+ *
+ * @param  pos - the total bytes position to copy from.
+ * @param  to - the buffer to copy to.
+ * @param  length - the number of bytes to copy.
+ */
+void LogRing_c::copyOut(unsigned long long pos, void * to, size_t length) const
+{
+    const size_t offset = pos % capacity;
+    const size_t first = std::min(length, capacity - offset);
+
+    memcpy(to, data + offset, first);
+    memcpy(static_cast<char *>(to) + first, data, length - first);
+}
+
+
+/**
+ * Add a record to the ring. Only one thread may push at a time.
+ *
+ * @param  file - the name of the log file.
+ * @param  lines - the lines to append to the log file.
+ * @return true if successful, false if there is no room.
+ */
+bool LogRing_c::push(const std::string & file, const std::string & lines)
+{
+    if (!header)
+    {
+        return false;
+    }
+
+    const unsigned int lengths[2]{static_cast<unsigned int>(file.size()), static_cast<unsigned int>(lines.size())};
+    const size_t record = sizeof(lengths) + file.size() + lines.size();
+
+    const unsigned long long head = header->head.load(std::memory_order_relaxed);
+    const unsigned long long tail = header->tail.load(std::memory_order_acquire);
+    if ((head - tail > capacity) || (record > capacity - (head - tail)))
+    {
+        return false;
+    }
+
+    copyIn(head, lengths, sizeof(lengths));
+    copyIn(head + sizeof(lengths), file.data(), file.size());
+    copyIn(head + sizeof(lengths) + file.size(), lines.data(), lines.size());
+
+    header->head.store(head + record, std::memory_order_release);
+
+    return true;
+}
+
+
+/**
+ * Remove the oldest record from the ring. Only one thread may pop at a time.
+ * The shared positions and record lengths are checked against each other, if
+ * they are inconsistent the ring is marked as corrupt and no more records are
+ * removed.
+ *
+ * @param  file - the name of the log file.
+ * @param  lines - the lines to append to the log file.
+ * @return true if a record was removed, false if the ring is empty or corrupt.
+ */
+bool LogRing_c::pop(std::string & file, std::string & lines)
+{
+    if ((corrupt) || (isEmpty()))
+    {
+        return false;
+    }
+
+    const unsigned long long tail = header->tail.load(std::memory_order_relaxed);
+    const unsigned long long used = header->head.load(std::memory_order_acquire) - tail;
+    unsigned int lengths[2];
+    if ((used > capacity) || (used < sizeof(lengths)))
+    {
+        corrupt = true;
+
+        return false;
+    }
+
+    copyOut(tail, lengths, sizeof(lengths));
+    if (sizeof(lengths) + static_cast<unsigned long long>(lengths[0]) + lengths[1] > used)
+    {
+        corrupt = true;
+
+        return false;
+    }
+
+    file.resize(lengths[0]);
+    lines.resize(lengths[1]);
+    copyOut(tail + sizeof(lengths), file.data(), file.size());
+    copyOut(tail + sizeof(lengths) + file.size(), lines.data(), lines.size());
+
+    header->tail.store(tail + sizeof(lengths) + file.size() + lines.size(), std::memory_order_release);
+
+    return true;
+}
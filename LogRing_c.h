@@ -0,0 +1,102 @@
+/**
+ * @file    LogRing_c.h
+ * @author  Phil Lockett <phillockett65@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Interface for the shared memory ring buffer used to pass log file writes
+ * from a logging process to the local log collector (logd).
+ */
+
+#if !defined(_LOGRING_C_H__20261018_1400__INCLUDED_)
+#define _LOGRING_C_H__20261018_1400__INCLUDED_
+
+#include <sys/types.h>
+#include <string>
+#include <atomic>
+
+
+/**
+ * @section shared memory ring buffer interface.
+ *
+ * A single producer, single consumer ring of records in POSIX shared memory.
+ * Each record holds the name of a log file and the lines to append to it.
+ * The producer is the logging process, the consumer is the collector.
+ */
+
+class LogRing_c
+{
+public:
+    static const size_t DEFAULT_SIZE{1 << 22};  // Default size of the record data area.
+    static constexpr const char * NAME_PREFIX{"/logger."};  // Prefix of all ring names.
+
+    LogRing_c(void) : header{}, data{}, size{}, capacity{}, uid{}, gid{}, corrupt{} {}
+    virtual ~LogRing_c(void) { detach(); }
+
+//- Delete the copy constructor and assignement operator.
+    LogRing_c(const LogRing_c &) = delete;
+    void operator=(const LogRing_c &) = delete;
+
+    static std::string getDefaultName(void);
+    static bool exists(const std::string & ring);
+
+    bool create(const std::string & ring, size_t bytes = DEFAULT_SIZE);
+    bool attach(const std::string & ring);
+    void detach(void);
+    bool remove(void);
+
+    bool isAttached(void) const { return header != nullptr; }
+    const std::string & getName(void) const { return name; }
+    pid_t getOwner(void) const;
+    uid_t getUid(void) const { return uid; }
+    gid_t getGid(void) const { return gid; }
+    bool isEmpty(void) const;
+    bool isCorrupt(void) const { return corrupt; }
+
+    bool push(const std::string & file, const std::string & lines);
+    bool pop(std::string & file, std::string & lines);
+
+private:
+    static const unsigned int MAGIC{0x4c6f6752};    // Marks the ring as ready.
+
+    struct Header_t
+    {
+        std::atomic<unsigned int> magic;
+        pid_t owner;                            // Process that created the ring.
+        size_t size;                            // Size of the record data area.
+        std::atomic<unsigned long long> head;   // Total bytes written.
+        std::atomic<unsigned long long> tail;   // Total bytes read.
+    };
+
+    static_assert(std::atomic<unsigned long long>::is_always_lock_free, "Ring positions must be lock free to be shared.");
+
+    bool map(int fd, size_t bytes);
+    void copyIn(unsigned long long pos, const void * from, size_t length);
+    void copyOut(unsigned long long pos, void * to, size_t length) const;
+
+    std::string name;
+    Header_t * header;
+    char * data;
+    size_t size;                                // Size of the whole mapping.
+    size_t capacity;                            // Size of the record data area, fixed when mapped.
+    uid_t uid;                                  // User that owns the shared memory.
+    gid_t gid;                                  // Group that owns the shared memory.
+    bool corrupt;                               // An invalid record was found.
+
+};
+
+#endif // !defined(_LOGRING_C_H__20261018_1400__INCLUDED_)
@@ -22,168 +22,1711 @@
  */
 
 #include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
+#include <regex>
+#include <string_view>
+#include <queue>
+#include <thread>
 
 #include "Log_c.h"
 
 
+/**
+ * @section Logging policies.
+ *
+ * Implementation of the compile time policies.
+ */
+
+/**
+ * Capture the offset between the monotonic and wall clocks.
+ *
+ * @return the offset in nanoseconds.
+ */
+static long long getMonotonicOffset(void)
+{
+    struct timespec real;
+    struct timespec mono;
+    clock_gettime(CLOCK_REALTIME, &real);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+
+    return ((real.tv_sec - mono.tv_sec) * 1000000000LL) + (real.tv_nsec - mono.tv_nsec);
+}
+
+const long long MonotonicClock_t::OFFSET{getMonotonicOffset()};
+const long long CoarseClock_t::OFFSET{MonotonicClock_t::OFFSET};
+
+
+
+
 /**
  * @section Logging Singleton.
  *
- * Implementation of the Logging Singleton. This code does the work of
- * formatting log entries, caching them and writing them to the log file.
+ * Implementation of the Logging Singleton. This code does the work of
+ * formatting log entries, caching them and writing them to the log file.
+ */
+
+Logger_c * Logger_c::instance{};
+
+
+/**
+ * Create the single threaded logging singleton and arrange for it to be
+ * destroyed, writing any cached entries, at exit.
+ *
+ * @return the logging singleton.
+ */
+Logger_c * Logger_c::_createInstance(void)
+{
+    instance = new Logger_c;
+    std::atexit([]() { delete instance; instance = nullptr; });
+
+    return instance;
+}
+
+
+/**
+ * Hidden default constructor. Only the first shard is used initially.
+ */
+Logger_c::Logger_c(void) : commitWindow{}, stopping{}, shardCount{1}, mergeDay{}, syncLevel{}, durability{Durability_t::NONE}, syncWindow{100}, timestamp{true}, moduleFiles{}, mergeShards{}
+{
+    for (int i = 0; i < MAX_SHARDS; ++i)
+    {
+        shards[i].index = i;
+        _calibrate(shards[i].calibration);
+    }
+}
+
+
+/**
+ * Hidden destructor, writes any cached entries, merges the shard files if
+ * required and removes the shared memory ring if it is empty.
+ */
+Logger_c::~Logger_c(void)
+{
+    _stopWriter();
+
+    if (mergeShards)
+    {
+        merge();
+    }
+    else
+    {
+        flush();
+    }
+
+    _enableSharedMemory(false);
+    _closeAllFiles();
+}
+
+
+/**
+ * Get a number identifying the current day, used to detect the day changing.
+ *
+ * @return the year and the day of the year combined.
+ */
+int Logger_c::_getDay(void)
+{
+    time_t now = time(NULL);
+    struct tm tim;
+    localtime_r(&now, &tim);
+
+    return ((tim.tm_year + 1900) * 1000) + tim.tm_yday;
+}
+
+
+/**
+ * Strip the padding from a module name.
+ *
+ * @param  module - the module name, possibly padded with spaces.
+ * @return a new string containing the module name without trailing spaces.
+ */
+std::string Logger_c::_trim(const std::string & module)
+{
+    const size_t last = module.find_last_not_of(' ');
+    if (last == std::string::npos)
+    {
+        return std::string{};
+    }
+
+    return module.substr(0, last + 1);
+}
+
+
+/**
+ * Replace the characters of a log file name stem that are unsafe in a file
+ * name, so that the stem can not escape the log file path.
+ *
+ * @param  name - the proposed name stem.
+ * @return a new string containing the safe name stem.
+ */
+std::string Logger_c::_sanitize(const std::string & name)
+{
+    std::string stem{name};
+    auto unsafe = [](char c) { return !isalnum(static_cast<unsigned char>(c)) && (c != '-') && (c != '_') && (c != '.'); };
+    std::replace_if(stem.begin(), stem.end(), unsafe, '_');
+
+    return stem;
+}
+
+
+/**
+ * Determine the name stem of the log file that a module logs to. This is the
+ * explicitly mapped name if there is one, otherwise the module name with
+ * unsafe characters replaced if module files are enabled, otherwise the
+ * shared log file.
+ *
+ * @param  module - the trimmed module name.
+ * @return a new string containing the log file name stem.
+ */
+std::string Logger_c::_resolveFileStem(const std::string & module) const
+{
+    auto mapped = moduleMap.find(module);
+    if (mapped != moduleMap.end())
+    {
+        return mapped->second;
+    }
+
+    if (moduleFiles && !module.empty())
+    {
+        return _sanitize(module);
+    }
+
+    return LOG_FILE_STEM;
+}
+
+
+/**
+ * Look up the name stem of the log file that a module logs to, remembering
+ * the result in the shard.
+ *
+ * @param  shard - the shard holding the resolved name stems.
+ * @param  module - the trimmed module name.
+ * @return a new string containing the log file name stem.
+ */
+std::string Logger_c::_getFileStem(const Shard_t & shard, const std::string & module) const
+{
+    auto & stems = shard.stems;
+    auto it = stems.find(module);
+    if (it != stems.end())
+    {
+        return it->second;
+    }
+
+    const std::string stem = _resolveFileStem(module);
+    stems[module] = stem;
+
+    return stem;
+}
+
+
+/**
+ * Construct the full log file name for todays log file. When sharding, each
+ * shard writes to its own numbered segment of the log file.
+ *
+ * @param  stem - the name stem of the log file.
+ * @param  segment - the shard number of the segment, negative for none.
+ * @param  when - a time on the day of the log file, 0 for today.
+ * @return a new string containing the log file name.
+ */
+std::string Logger_c::_getFullLogFileName(const std::string & stem, int segment, time_t when) const
+{
+    time_t now = when ? when : time(NULL);
+    struct tm tim;
+    localtime_r(&now, &tim);
+    char FileName[FILE_NAME_LENGTH];
+
+    const char * path = logFilePath.c_str();
+    if (segment < 0)
+    {
+        snprintf(FileName, FILE_NAME_LENGTH, "%s/%s-%04d-%02d-%02d.txt", path, stem.c_str(), tim.tm_year + 1900, tim.tm_mon + 1, tim.tm_mday);
+    }
+    else
+    {
+        snprintf(FileName, FILE_NAME_LENGTH, "%s/%s-%04d-%02d-%02d.s%02d.txt", path, stem.c_str(), tim.tm_year + 1900, tim.tm_mon + 1, tim.tm_mday, segment);
+    }
+
+    return std::string(FileName);
+}
+
+
+/**
+ * Sets the path for the log files and ensures that the directory exists.
+ *
+ * @return true if successful, false otherwise.
+ */
+bool Logger_c::_setLogFilePath(const std::string & path)
+{
+    if (path.empty())
+    {
+        return false;
+    }
+
+//- Save the new path and Strip off trailing '/' if present.
+    const std::string JUNK = "/\n\r\\";
+    const size_t last = path.find_last_not_of(JUNK);
+    if (last == std::string::npos)
+    {
+        logFilePath = path;
+    }
+    else
+    {
+        logFilePath = path.substr(0, last + 1);
+    }
+
+//- Create directory.
+    return std::filesystem::create_directories(logFilePath);
+}
+
+
+/**
+ * Route the log entries of a module to a separate log file. Unsafe characters
+ * in the name are replaced, as they are for module names.
+ *
+ * @param  module - the module name.
+ * @param  name - the name stem of the log file, empty to remove the mapping.
+ * @return true if successful, false otherwise.
+ */
+bool Logger_c::_setModuleFile(const std::string & module, const std::string & name)
+{
+    const std::string key = _trim(module);
+    if (key.empty())
+    {
+        return false;
+    }
+
+    if (name.empty())
+    {
+        moduleMap.erase(key);
+    }
+    else
+    {
+        moduleMap[key] = _sanitize(name);
+    }
+
+    _clearStems();
+
+    return true;
+}
+
+
+/**
+ * Change the number of shards in use, writing the cached entries of all
+ * shards first.
+ *
+ * @param  count - the number of shards to use.
+ * @return true if successful, false otherwise.
+ */
+bool Logger_c::setShards(int count)
+{
+    if ((count < 1) || (count > MAX_SHARDS))
+    {
+        return false;
+    }
+
+    AllShardsLock_t lock(*this);
+    for (auto & shard : shards)
+    {
+        _flush(shard);
+    }
+
+    _closeAllFiles();
+    shardCount = count;
+
+    return true;
+}
+
+
+/**
+ * Get the slot of the calling thread, used to select its shard. Threads are
+ * spread over the shards in use in the order that they first log.
+ *
+ * @return the slot of the calling thread.
+ */
+int Logger_c::_getSlot(void)
+{
+    static std::atomic<int> nextSlot{};
+    thread_local const int slot{nextSlot++};
+
+    return slot;
+}
+
+
+/**
+ * Close all the cached log file handles of a shard, first writing any lines
+ * still waiting for room in the shared memory ring.
+ *
+ * @param  shard - the shard to close the files of.
+ */
+void Logger_c::_closeFiles(Shard_t & shard)
+{
+    for (auto & [stem, file] : shard.files)
+    {
+        if (!file.buffer.empty())
+        {
+            _writeFile(shard, stem, file, false);
+        }
+
+        if (file.fd >= 0)
+        {
+            if (file.reserved)
+            {
+                _trim(file.fd);
+            }
+
+            if ((file.dirty) && (durability != Durability_t::NONE))
+            {
+                fdatasync(file.fd);
+            }
+            close(file.fd);
+        }
+    }
+
+    shard.files.clear();
+    shard.preparedDay = 0;
+}
+
+
+/**
+ * Start or stop passing the log file writes to the local collector (logd)
+ * through a shared memory ring. When stopping, the ring is removed if it is
+ * empty, otherwise it is left for the collector to drain and remove. When
+ * starting, a ring left by this process is reused.
+ *
+ * @param  enable - true to use shared memory, false to write directly.
+ * @return true if successful, false otherwise.
+ */
+bool Logger_c::_enableSharedMemory(bool enable)
+{
+    if (enable == ring.isAttached())
+    {
+        return true;
+    }
+
+//- The log file names sent to the collector differ, so start afresh.
+    _closeAllFiles();
+
+    if (!enable)
+    {
+        if (ring.isEmpty())
+        {
+            ring.remove();
+        }
+        ring.detach();
+
+        return true;
+    }
+
+    const std::string name = LogRing_c::getDefaultName();
+    if (ring.create(name))
+    {
+        return true;
+    }
+
+    if ((ring.attach(name)) && (ring.getOwner() == getpid()) && (ring.getUid() == geteuid()))
+    {
+        return true;
+    }
+    ring.detach();
+
+    return false;
+}
+
+
+/**
+ * Add the lines for a log file to the shared memory ring without waiting.
+ *
+ * @param  name - the full log file name.
+ * @param  lines - the lines to append to the log file.
+ * @return true if successful, false if there is no room.
+ */
+bool Logger_c::_push(const std::string & name, const std::string & lines)
+{
+    std::lock_guard<Mutex_t> lock(ringMutex);
+
+    return ring.push(name, lines);
+}
+
+
+/**
+ * Close the cached file handles of a shard if the day has changed.
+ *
+ * @param  shard - the shard to check.
+ */
+void Logger_c::_checkDay(Shard_t & shard)
+{
+    const int today = _getDay();
+    if (today != shard.fileDay)
+    {
+        _closeFiles(shard);
+        shard.fileDay = today;
+    }
+}
+
+
+/**
+ * Reserve disk space beyond the end of a log file so that appending to it
+ * does not need to allocate blocks. The file size is unchanged.
+ *
+ * @param  fd - the log file handle.
+ * @return true if space was reserved, false otherwise.
+ */
+bool Logger_c::_preallocate(int fd)
+{
+#if defined(__linux__)
+    struct stat status;
+    if (fstat(fd, &status) == 0)
+    {
+        return fallocate(fd, FALLOC_FL_KEEP_SIZE, status.st_size, PREALLOCATE_SIZE) == 0;
+    }
+#endif
+
+    return false;
+}
+
+
+/**
+ * Release the disk space reserved beyond the end of a log file that was not
+ * used.
+ *
+ * @param  fd - the log file handle.
+ */
+void Logger_c::_trim(int fd)
+{
+    struct stat status;
+    if (fstat(fd, &status) == 0)
+    {
+        ftruncate(fd, status.st_size);
+    }
+}
+
+
+/**
+ * Set the full name of a log file if it is not already known. The collector
+ * does not share the working directory, so it is sent absolute names.
+ *
+ * @param  shard - the shard writing the file.
+ * @param  stem - the name stem of the log file.
+ * @param  file - the cached handle of the log file.
+ */
+void Logger_c::_setFileName(const Shard_t & shard, const std::string & stem, File_t & file)
+{
+    if (file.name.empty())
+    {
+        const int segment = (shardCount > 1) ? shard.index : -1;
+        file.name = _getFullLogFileName(stem, segment);
+        if (ring.isAttached())
+        {
+            file.name = std::filesystem::absolute(file.name).string();
+        }
+    }
+}
+
+
+/**
+ * Open a log file if it is not already open. Disk space is reserved for the
+ * shared log file, unless sharded or passing writes to the collector, and
+ * for any file when asked. The reservation is released when the file is
+ * closed.
+ *
+ * @param  shard - the shard writing the file.
+ * @param  stem - the name stem of the log file.
+ * @param  file - the cached handle of the log file.
+ * @param  reserve - reserve disk space whichever file it is.
+ * @return true if the log file is open, false otherwise.
+ */
+bool Logger_c::_openFile(const Shard_t & shard, const std::string & stem, File_t & file, bool reserve)
+{
+    _setFileName(shard, stem, file);
+
+    if (file.fd < 0)
+    {
+        file.fd = open(file.name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if ((file.fd >= 0) && ((reserve) || ((stem == LOG_FILE_STEM) && (shardCount == 1) && (!ring.isAttached()))))
+        {
+            file.reserved = _preallocate(file.fd);
+        }
+    }
+
+    return file.fd >= 0;
+}
+
+
+/**
+ * Shortly before midnight, create the next days log files of a shard so that
+ * the first write after midnight only has to open them.
+ *
+ * @param  shard - the shard to create the files for.
+ */
+void Logger_c::_prepareNextDay(Shard_t & shard)
+{
+    if ((ring.isAttached()) || (shard.preparedDay == shard.fileDay))
+    {
+        return;
+    }
+
+    time_t now = time(NULL);
+    struct tm tim;
+    localtime_r(&now, &tim);
+    const int remaining = (24 * 60 * 60) - ((tim.tm_hour * 60 * 60) + (tim.tm_min * 60) + tim.tm_sec);
+    if (remaining > ROLLOVER_LEAD)
+    {
+        return;
+    }
+
+    const int segment = (shardCount > 1) ? shard.index : -1;
+    for (const auto & [stem, file] : shard.files)
+    {
+        const int fd = open(_getFullLogFileName(stem, segment, now + remaining).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    shard.preparedDay = shard.fileDay;
+}
+
+
+/**
+ * Prepare to log without first use delays: set up the log path, open and
+ * reserve disk space for the current log files, touch the cache memory and
+ * create the next days log files if it is nearly midnight.
+ *
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::warmUp(void)
+{
+    int ret = 0;
+
+    AllShardsLock_t lock(*this);
+    _checkFilePath();
+
+    std::error_code ec;
+    std::filesystem::create_directories(logFilePath, ec);
+
+    std::vector<std::string> stems{LOG_FILE_STEM};
+    for (const auto & [module, stem] : moduleMap)
+    {
+        stems.push_back(stem);
+    }
+
+    auto touch = [](std::string & buffer, size_t size) { buffer.assign(size, '\0'); buffer.clear(); };
+    for (int i = 0; i < shardCount; ++i)
+    {
+        Shard_t & shard = shards[i];
+        for (auto & entry : shard.cache)
+        {
+            touch(entry.line, LINE_LENGTH);
+        }
+
+        _checkDay(shard);
+        for (const auto & stem : stems)
+        {
+            File_t & file = shard.files[stem];
+            touch(file.buffer, MAX_LINES * LINE_LENGTH);
+            if ((!ring.isAttached()) && (!_openFile(shard, stem, file, true)))
+            {
+                ret = -3;
+            }
+        }
+
+        _prepareNextDay(shard);
+    }
+
+    return ret;
+}
+
+
+/**
+ * Write the lines gathered for a log file, opening the file if necessary,
+ * then clear the gathered lines. When using shared memory and the ring is
+ * full, the lines are kept to be passed to the collector with the next write
+ * of the file, so that they stay in order. If too many lines are kept, or
+ * they can not be kept, they are written directly and may be out of order
+ * with lines still in the ring, which is counted as a fallback. Flushing and
+ * syncing do not keep lines, see _writeKept().
+ *
+ * @param  shard - the shard writing the file.
+ * @param  stem - the name stem of the log file.
+ * @param  file - the cached handle and gathered lines of the log file.
+ * @param  keep - keep the lines if the ring is full.
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::_writeFile(Shard_t & shard, const std::string & stem, File_t & file, bool keep)
+{
+    int ret = 0;
+
+    _setFileName(shard, stem, file);
+
+//- Pass the lines to the collector when using shared memory.
+    if (ring.isAttached())
+    {
+        if (_push(file.name, file.buffer))
+        {
+            shard.stats.bytes += file.buffer.size();
+            file.buffer.clear();
+
+            return 0;
+        }
+
+        if ((keep) && (file.buffer.size() < RING_BACKLOG))
+        {
+            return 0;
+        }
+
+        ++shard.stats.fallbacks;
+    }
+
+    _openFile(shard, stem, file);
+
+    const char * p = file.buffer.data();
+    size_t remaining = file.buffer.size();
+    while ((file.fd >= 0) && (remaining))
+    {
+        const ssize_t written = ::write(file.fd, p, remaining);
+        if (written < 0)
+        {
+            break;
+        }
+
+        p += written;
+        remaining -= written;
+    }
+
+    if (remaining)
+    {
+        ret = -3;
+    }
+
+    shard.stats.bytes += file.buffer.size() - remaining;
+    file.dirty = true;
+    file.buffer.clear();
+
+    return ret;
+}
+
+
+/**
+ * Pass the lines kept for the log files of a shard to the collector, or write
+ * them directly if the ring is still full, so that none are left behind.
+ *
+ * @param  shard - the shard writing the files.
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::_writeKept(Shard_t & shard)
+{
+    int ret = 0;
+
+    for (auto & [stem, file] : shard.files)
+    {
+        if (!file.buffer.empty())
+        {
+            const int err = _writeFile(shard, stem, file, false);
+            if (err)
+            {
+                ret = err;
+            }
+        }
+    }
+
+    return ret;
+}
+
+
+/**
+ * Write log entries of a shard into the current log files.
+ *
+ * @param  shard - the shard writing the entries.
+ * @param  entries - the log entries to write.
+ * @param  count - the number of log entries.
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::_write(Shard_t & shard, const Entry_t * entries, int count)
+{
+    int ret = 0;
+
+    // Set up default log path, if necessary.
+    _checkFilePath();
+
+//- Close the cached file handles if the day has changed.
+    _checkDay(shard);
+
+//- Calibrate the raw time stamps up to now against the wall clock, then
+//  interpolate from the previous reference point at the newly measured rate.
+    Calibration_t & calibration = shard.calibration;
+    Calibration_t previous = calibration;
+    if constexpr (Clock_t::CALIBRATED)
+    {
+        _calibrate(calibration);
+        previous.rate = calibration.rate;
+    }
+
+//- Gather the lines for each log file, converting the time stamps.
+    auto & files = shard.files;
+    File_t * target = &files[LOG_FILE_STEM];
+    const std::string * module = nullptr;
+    char stamp[LINE_LENGTH];
+    for (int i = 0; i < count; ++i)
+    {
+        const Entry_t & entry = entries[i];
+        if ((module == nullptr) || (entry.module != *module))
+        {
+            module = &entry.module;
+            target = module->empty() ? &files[LOG_FILE_STEM] : &files[_getFileStem(shard, *module)];
+        }
+
+        if (entry.stamp)
+        {
+            if constexpr (Clock_t::CALIBRATED)
+            {
+//- A batch split across writes shares one raw time stamp, so convert it to
+//  the same wall clock time each time, whatever the rate is now.
+                if (entry.stamp != calibration.stamp)
+                {
+                    calibration.stamp = entry.stamp;
+                    calibration.wall = _getWallClock(previous, entry.stamp);
+                }
+                target->buffer.append(stamp, _getTimestamp(stamp, calibration.wall));
+            }
+            else
+            {
+                target->buffer.append(stamp, _getTimestamp(stamp, entry.stamp + Clock_t::OFFSET));
+            }
+        }
+        target->buffer += entry.line;
+        target->buffer += '\n';
+    }
+
+//- Write all the gathered lines in one pass.
+    const auto start = std::chrono::steady_clock::now();
+    for (auto & [stem, file] : files)
+    {
+        if (!file.buffer.empty())
+        {
+            const int err = _writeFile(shard, stem, file);
+            if (err)
+            {
+                ret = err;
+            }
+        }
+    }
+
+    const auto finish = std::chrono::steady_clock::now();
+    ++shard.stats.flushes;
+    shard.stats.lines += count;
+    shard.stats.writeNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count();
+
+//- Group commit everything written since the last sync once the window ends.
+    if ((durability == Durability_t::GROUP_COMMIT) && (finish - shard.lastSync >= syncWindow))
+    {
+        const int err = _sync(shard);
+        if (err)
+        {
+            ret = err;
+        }
+    }
+
+    _prepareNextDay(shard);
+
+    return ret;
+}
+
+
+/**
+ * Select how written log entries are made durable. When group committing in
+ * multi threaded builds, the writer thread writes the caches and syncs the
+ * log files once per sync window, even if nothing else writes them. Single
+ * threaded builds check the window when logging instead.
+ *
+ * @param  mode - the durability mode.
+ * @param  window - the sync window in milliseconds.
+ */
+void Logger_c::setDurability(Durability_t mode, int window)
+{
+    AllShardsLock_t lock(*this);
+    durability = mode;
+    syncWindow = std::chrono::milliseconds(window);
+
+    if constexpr (Threading_t::MULTI_THREADED)
+    {
+        {
+            std::lock_guard<std::mutex> queueLock(queueMutex);
+            commitWindow = (mode == Durability_t::GROUP_COMMIT) ? std::max(syncWindow, std::chrono::milliseconds(1)) : std::chrono::milliseconds::zero();
+            if (commitWindow.count())
+            {
+                _startWriter();
+            }
+        }
+        queueReady.notify_one();
+    }
+}
+
+
+/**
+ * Write the caches and sync the log files of the shards that have not been
+ * synced for the sync window. This runs on the writer thread, which must never
+ * block on a shard, as the holder may be waiting for an asynchronous write
+ * that only the writer thread can run. So busy shards, and shards with
+ * asynchronous writes still queued, are left to the next window.
+ */
+void Logger_c::_commit(void)
+{
+    for (auto & shard : shards)
+    {
+        std::unique_lock<Mutex_t> lock(shard.logMutex, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            continue;
+        }
+
+        if ((shard.pending.valid()) && (shard.pending.wait_for(std::chrono::seconds::zero()) != std::future_status::ready))
+        {
+            continue;
+        }
+
+        if ((durability != Durability_t::GROUP_COMMIT) || (std::chrono::steady_clock::now() - shard.lastSync < syncWindow))
+        {
+            continue;
+        }
+
+        auto waiting = [](const auto & entry) { return (entry.second.dirty) || (!entry.second.buffer.empty()); };
+        if (shard.count)
+        {
+            _flush(shard);
+        }
+        else
+        if (std::any_of(shard.files.begin(), shard.files.end(), waiting))
+        {
+            _sync(shard);
+        }
+    }
+}
+
+
+/**
+ * Sync the log files written by a shard since they were last synced, first
+ * writing any lines kept for the collector.
+ *
+ * @param  shard - the shard to sync the files of.
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::_sync(Shard_t & shard)
+{
+    int ret = _writeKept(shard);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto & [stem, file] : shard.files)
+    {
+        if ((file.dirty) && (file.fd >= 0))
+        {
+            if (fdatasync(file.fd) < 0)
+            {
+                ret = -4;
+            }
+            ++shard.stats.syncs;
+        }
+        file.dirty = false;
+    }
+
+    shard.lastSync = std::chrono::steady_clock::now();
+    shard.stats.syncNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(shard.lastSync - start).count();
+
+    return ret;
+}
+
+
+/**
+ * Write the caches of all shards then sync all the log files written since
+ * they were last synced.
+ *
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::sync(void)
+{
+    int ret = flush();
+
+    for (auto & shard : shards)
+    {
+        std::lock_guard<Mutex_t> lock(shard.logMutex);
+        _waitPending(shard);
+
+        const int err = _sync(shard);
+        if (err)
+        {
+            ret = err;
+        }
+    }
+
+    return ret;
+}
+
+
+/**
+ * Get the totals of the flush statistics of all shards.
+ *
+ * @return the flush statistics.
+ */
+Logger_c::FlushStats_t Logger_c::getFlushStats(void) const
+{
+    FlushStats_t ret{};
+
+    AllShardsLock_t lock(*this);
+    for (const auto & shard : shards)
+    {
+        ret.flushes += shard.stats.flushes;
+        ret.lines += shard.stats.lines;
+        ret.bytes += shard.stats.bytes;
+        ret.writeNanos += shard.stats.writeNanos;
+        ret.syncs += shard.stats.syncs;
+        ret.syncNanos += shard.stats.syncNanos;
+        ret.fallbacks += shard.stats.fallbacks;
+    }
+
+    return ret;
+}
+
+
+/**
+ * Write the cache of a shard into the current log files then clear the cache.
+ * Any asynchronous write of the shard is completed first to keep the order.
+ *
+ * @param  shard - the shard to write.
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::_flush(Shard_t & shard)
+{
+    _waitPending(shard);
+
+    const int ret = _write(shard, shard.cache.data(), shard.count);
+
+//- Clear the cache.
+    shard.count = 0;
+
+    return ret;
+}
+
+
+/**
+ * Run the queued asynchronous writes in order on the writer thread until
+ * stopped and the queue is empty. When group committing, the shards are also
+ * committed whenever the writer is idle for the sync window.
+ */
+void Logger_c::_writer(void)
+{
+    auto ready = [this]() { return (stopping) || (!queue.empty()); };
+
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true)
+    {
+        const auto window = commitWindow;
+        auto changed = [this, &ready, window]() { return (ready()) || (commitWindow != window); };
+        if (window.count() == 0)
+        {
+            queueReady.wait(lock, changed);
+        }
+        else
+        if (!queueReady.wait_for(lock, window, changed))
+        {
+            lock.unlock();
+            _commit();
+            lock.lock();
+
+            continue;
+        }
+
+        if (!ready())
+        {
+            continue;
+        }
+
+        if (queue.empty())
+        {
+            return;
+        }
+
+        std::packaged_task<int()> task{std::move(queue.front())};
+        queue.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+
+/**
+ * Stop the writer thread once it has run all the queued writes.
+ */
+void Logger_c::_stopWriter(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_one();
+
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
+
+
+/**
+ * Take the caches of all shards and queue them to be written into the current
+ * log files by the writer thread, which is started on first use. The writes of
+ * each shard are chained after any earlier asynchronous write of that shard.
+ *
+ * @return a future holding the negative error value or 0 if no errors, ready
+ * when all entries logged before the call are written.
  */
+std::shared_future<int> Logger_c::flushAsync(void)
+{
+    struct Batch_t
+    {
+        Shard_t * shard;
+        std::shared_future<int> previous;
+        std::vector<Entry_t> entries;
+    };
+    auto batches = std::make_shared<std::vector<Batch_t>>();
+
+    std::vector<std::unique_lock<Mutex_t>> locks;
+    locks.reserve(MAX_SHARDS);
+    for (auto & shard : shards)
+    {
+        std::unique_lock<Mutex_t> lock(shard.logMutex);
+        if ((shard.pending.valid()) && (shard.pending.wait_for(std::chrono::seconds::zero()) == std::future_status::ready))
+        {
+            shard.pending = std::shared_future<int>{};
+        }
+
+        if ((shard.count == 0) && (!shard.pending.valid()))
+        {
+            continue;
+        }
+
+        Batch_t batch{&shard, shard.pending, {}};
+        batch.entries.reserve(shard.count);
+        std::move(shard.cache.begin(), shard.cache.begin() + shard.count, std::back_inserter(batch.entries));
+        shard.count = 0;
+
+        batches->push_back(std::move(batch));
+        locks.push_back(std::move(lock));
+    }
+
+//- Nothing to write.
+    if (batches->empty())
+    {
+        std::promise<int> done;
+        done.set_value(0);
+
+        return done.get_future().share();
+    }
+
+    auto write = [this, batches]()
+    {
+        int ret = 0;
+        for (auto & batch : *batches)
+        {
+            int err = batch.previous.valid() ? batch.previous.get() : 0;
+            if (!batch.entries.empty())
+            {
+                const int written = _write(*batch.shard, batch.entries.data(), static_cast<int>(batch.entries.size()));
+                if (written)
+                {
+                    err = written;
+                }
+            }
+
+            const int kept = _writeKept(*batch.shard);
+            if (kept)
+            {
+                err = kept;
+            }
+
+        //- Release the earlier write and the entries now they are finished with.
+            batch.previous = std::shared_future<int>{};
+            batch.entries.clear();
+            batch.entries.shrink_to_fit();
+            if (err)
+            {
+                ret = err;
+            }
+        }
+
+        return ret;
+    };
+
+//- Chain the write on the shards before releasing them.
+    std::packaged_task<int()> task{write};
+    std::shared_future<int> ret = task.get_future().share();
+    for (auto & batch : *batches)
+    {
+        batch.shard->pending = ret;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        _startWriter();
+        queue.push_back(std::move(task));
+    }
+    queueReady.notify_one();
+
+    return ret;
+}
 
 
 /**
- * Construct the full log file name for todays log file.
+ * Write the caches of all shards into the current log files. When sharding
+ * with merging enabled, the shard files of previous days are merged once the
+ * day changes, without holding the shard locks.
  *
- * @return a new string containing the log file name.
+ * @return negative error value or 0 if no errors.
  */
-std::string Logger_c::_getFullLogFileName(void) const
+int Logger_c::flush(void)
 {
-    time_t now = time(NULL);
-    struct tm tim = *localtime(&now);
-    char FileName[FILE_NAME_LENGTH];
+    int ret = 0;
 
-    const char * path = logFilePath.c_str();
-    sprintf(FileName, "%s/log-%04d-%02d-%02d.txt", path, tim.tm_year + 1900, tim.tm_mon + 1, tim.tm_mday);
+//- Shards beyond those in use may still hold entries if the count was reduced,
+//  so write them and release their files too.
+    for (auto & shard : shards)
+    {
+        std::lock_guard<Mutex_t> lock(shard.logMutex);
+        if (shard.count)
+        {
+            const int err = _flush(shard);
+            if (err)
+            {
+                ret = err;
+            }
+        }
+        else
+        {
+            _waitPending(shard);
+        }
 
-    return std::string(FileName);
+        const int err = _writeKept(shard);
+        if (err)
+        {
+            ret = err;
+        }
+
+        if (shard.index >= shardCount)
+        {
+            _closeFiles(shard);
+        }
+    }
+
+    if ((shardCount > 1) && (mergeShards) && (_getDay() != mergeDay))
+    {
+        const int err = _merge(false);
+        if (err)
+        {
+            ret = err;
+        }
+    }
+
+    return ret;
 }
 
 
 /**
- * Sets the path for the log files and ensures that the directory exists.
+ * Write the caches of all shards then merge all the shard files, including
+ * todays, into their log files.
  *
- * @return true if successful, false otherwise.
+ * @return negative error value or 0 if no errors.
  */
-bool Logger_c::_setLogFilePath(const std::string & path)
+int Logger_c::merge(void)
 {
-    if (path.empty())
+    const int ret = flush();
+    const int err = _merge(true);
+
+    return err ? err : ret;
+}
+
+
+/**
+ * Merge the shard segment files into single time ordered log files. Each
+ * shard is locked in turn only to close its files, the segments are merged
+ * without holding the shard locks. Todays segments are still being written,
+ * so when they are merged too, each is first closed and renamed aside under
+ * the lock of its shard, which then starts a new segment. While the collector
+ * may still write the segments, that is while shared memory is used or its
+ * ring has not been drained, nothing is merged.
+ *
+ * @param  all - merge todays segments as well as those of previous days.
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::_merge(bool all)
+{
+    int ret = 0;
+
+    std::lock_guard<Mutex_t> mergeLock(mergeMutex);
+    const int day = _getDay();
+    if ((!all) && (day == mergeDay))
     {
-        return false;
+        return 0;
     }
 
-//- Save the new path and Strip off trailing '/' if present.
-    const std::string JUNK = "/\n\r\\";
-    const size_t last = path.find_last_not_of(JUNK);
-    if (last == std::string::npos)
     {
-        logFilePath = path;
+        std::lock_guard<Mutex_t> lock(shards[0].logMutex);
+        if ((ring.isAttached()) || (LogRing_c::exists(LogRing_c::getDefaultName())))
+        {
+            return 0;
+        }
     }
-    else
+
+//- Close the files of previous days, no shard writes them once the day changes.
+    std::filesystem::path path;
+    bool ordered{};
+    for (auto & shard : shards)
     {
-        logFilePath = path.substr(0, last + 1);
+        std::lock_guard<Mutex_t> lock(shard.logMutex);
+        _waitPending(shard);
+        _checkDay(shard);
+        if (shard.index == 0)
+        {
+            path = logFilePath;
+            ordered = (Clock_t::ENABLED) && (timestamp);
+        }
     }
 
-//- Create directory.
-    return std::filesystem::create_directories(logFilePath);
+//- Collect the segment files for each log file, and those being written today.
+    static const std::regex segmentName{R"((.*)\.s([0-9]{2})\.(txt|merging))"};
+    time_t now = time(NULL);
+    struct tm tim;
+    localtime_r(&now, &tim);
+    char today[16];
+    strftime(today, sizeof(today), "-%Y-%m-%d", &tim);
+    std::map<std::filesystem::path, std::vector<std::filesystem::path>> segments;
+    std::map<int, std::vector<std::filesystem::path>> current;
+
+    std::error_code ec;
+    for (const auto & file : std::filesystem::directory_iterator(path, ec))
+    {
+        const std::string name = file.path().filename().string();
+        std::smatch match;
+        if (std::regex_match(name, match, segmentName))
+        {
+            const std::string base = match[1];
+            if ((match[3] == "merging") || (!base.ends_with(today)))
+            {
+                segments[path / (base + ".txt")].push_back(file.path());
+            }
+            else
+            if (all)
+            {
+                current[std::stoi(match[2])].push_back(file.path());
+            }
+        }
+    }
+
+//- Set todays segments aside, unless a segment set aside earlier is still there.
+    for (auto & [index, files] : current)
+    {
+        Shard_t & shard = shards[index];
+        std::lock_guard<Mutex_t> lock(shard.logMutex);
+        _waitPending(shard);
+        _closeFiles(shard);
+        for (const auto & file : files)
+        {
+            std::filesystem::path aside{file};
+            aside.replace_extension(".merging");
+            if (!std::filesystem::exists(aside, ec))
+            {
+                std::filesystem::rename(file, aside, ec);
+                if (!ec)
+                {
+                    const std::string name = file.filename().string();
+                    segments[path / (name.substr(0, name.size() - strlen(".s00.txt")) + ".txt")].push_back(aside);
+                }
+            }
+        }
+    }
+
+//- Merge the segments into their log files, only removing them once merged.
+    for (auto & [base, parts] : segments)
+    {
+        std::sort(parts.begin(), parts.end());
+        if (_mergeSegments(base, parts, ordered))
+        {
+            ret = -3;
+            continue;
+        }
+
+        for (const auto & part : parts)
+        {
+            std::filesystem::remove(part, ec);
+        }
+    }
+
+    mergeDay = day;
+
+    return ret;
 }
 
 
 /**
- * Write the cache into the current log file then clear the cache.
+ * Append the lines of several time ordered segment files to a log file in
+ * time order, reading a line at a time from each segment. Lines with equal
+ * time stamps, or all lines if there are no time stamps, are taken from the
+ * earlier segment first. The log file is synced before returning.
  *
+ * @param  base - the log file to append to.
+ * @param  parts - the segment files, in order.
+ * @param  ordered - the lines start with time stamps.
  * @return negative error value or 0 if no errors.
  */
-int Logger_c::_flush(void)
+int Logger_c::_mergeSegments(const std::filesystem::path & base, const std::vector<std::filesystem::path> & parts, bool ordered)
 {
-    int ret = 0;
+    const size_t length = ordered ? strlen("HH:MM:SS.uuuuuu") : 0;
 
-    // Set up default log path, if necessary.
-    std::call_once(checkFilePathSet, [this](){ if (logFilePath.empty()) _setLogFilePath("/logs"); });
+    struct Part_t
+    {
+        std::ifstream in;
+        std::string line;
+    };
+    std::vector<Part_t> inputs(parts.size());
 
-//- Write the cache to the log file.
-    std::ofstream outfile(_getFullLogFileName(), std::ofstream::out | std::ofstream::app);
-    const int entries = count;
-    auto line2Log = [&outfile](const auto & s) { outfile << s << '\n'; };
-    std::for_each_n(cache.begin(), entries, line2Log);
+    auto key = [length](const std::string & line) { return std::string_view{line}.substr(0, length); };
+    auto later = [&inputs, &key](size_t a, size_t b) { const auto x = key(inputs[a].line); const auto y = key(inputs[b].line); return (x > y) || ((x == y) && (a > b)); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heads{later};
 
-//- Clear the cache.
-    count = 0;
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        inputs[i].in.open(parts[i], std::ios::in | std::ios::binary);
+        if (!inputs[i].in.is_open())
+        {
+            return -3;
+        }
 
-    return ret;
+        if (std::getline(inputs[i].in, inputs[i].line))
+        {
+            heads.push(i);
+        }
+    }
+
+    std::error_code ec;
+    const bool created = !std::filesystem::exists(base, ec);
+    const int fd = open(base.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return -3;
+    }
+
+    bool ok = true;
+    std::string chunk;
+    auto put = [fd, &chunk]()
+    {
+        const char * p = chunk.data();
+        size_t remaining = chunk.size();
+        while (remaining)
+        {
+            const ssize_t written = ::write(fd, p, remaining);
+            if (written < 0)
+            {
+                return false;
+            }
+            p += written;
+            remaining -= written;
+        }
+        chunk.clear();
+
+        return true;
+    };
+
+//- Repeatedly take the earliest line of all the segments.
+    while ((ok) && (!heads.empty()))
+    {
+        const size_t i = heads.top();
+        heads.pop();
+
+        chunk += inputs[i].line;
+        chunk += '\n';
+        if (chunk.size() >= MAX_LINES * LINE_LENGTH)
+        {
+            ok = put();
+        }
+
+        if (std::getline(inputs[i].in, inputs[i].line))
+        {
+            heads.push(i);
+        }
+    }
+
+    ok = (ok) && (put()) && (fsync(fd) == 0);
+    close(fd);
+
+    for (const auto & input : inputs)
+    {
+        if (input.in.bad())
+        {
+            ok = false;
+        }
+    }
+
+//- A new log file also needs its directory entry synced.
+    if ((ok) && (created))
+    {
+        const int dir = open(base.parent_path().c_str(), O_RDONLY | O_CLOEXEC);
+        if (dir >= 0)
+        {
+            fsync(dir);
+            close(dir);
+        }
+    }
+
+    return ok ? 0 : -3;
 }
 
 
 /**
- * Insert a time stamp into the buffer pointed at by p.
+ * Take a new reference point for converting calibrated raw time stamps. The
+ * tick rate is measured since the previous reference point, so the time
+ * stamps in between are interpolated.
  *
- * @param p - pointer to buffer to hold time stamp.
- * @return the length of the time stamp.
+ * @param  calibration - the reference point to update.
  */
-int Logger_c::_getTimestamp(char * p) const
+void Logger_c::_calibrate(Calibration_t & calibration)
 {
     struct timespec tp;
     clock_gettime(CLOCK_REALTIME, &tp);
+    const unsigned long long ticks = Clock_t::now();
+    const long long nanos = (tp.tv_sec * 1000000000LL) + tp.tv_nsec;
+
+    if ((calibration.ticks) && (ticks > calibration.ticks))
+    {
+        calibration.rate = static_cast<double>(nanos - calibration.nanos) / static_cast<double>(ticks - calibration.ticks);
+    }
+
+    calibration.ticks = ticks;
+    calibration.nanos = nanos;
+}
+
+
+/**
+ * Convert a calibrated raw time stamp to wall clock time.
+ *
+ * @param  calibration - the reference point taken before the time stamp and
+ * the tick rate measured after it.
+ * @param  stamp - the raw time stamp.
+ * @return the wall clock time in nanoseconds.
+ */
+long long Logger_c::_getWallClock(const Calibration_t & calibration, unsigned long long stamp)
+{
+    const long long ticks = static_cast<long long>(stamp - calibration.ticks);
+
+    return calibration.nanos + static_cast<long long>(ticks * calibration.rate);
+}
 
-    struct tm tim = *localtime(&tp.tv_sec);
 
-    const int Micros = tp.tv_nsec/1000;
+/**
+ * Insert a time stamp into the buffer pointed at by p.
+ *
+ * @param p - pointer to buffer to hold time stamp.
+ * @param nanos - the wall clock time in nanoseconds.
+ * @return the length of the time stamp.
+ */
+int Logger_c::_getTimestamp(char * p, long long nanos)
+{
+    const time_t seconds = nanos / 1000000000LL;
+    struct tm tim;
+    localtime_r(&seconds, &tim);
+
+    const int Micros = (nanos % 1000000000LL) / 1000;
 
     return sprintf(p, "%02d:%02d:%02d.%06d ", tim.tm_hour, tim.tm_min, tim.tm_sec, Micros);
 }
+
+
 /**
- * Generates and caches the log entry.
+ * Generates a log entry. The log entry is truncated to LINE_LENGTH.
  *
+ * @param  entry - the log entry to generate.
  * @param  qualifier - log entry qualifier, usually module name and log level.
  * @param  format - the log entry format string.
  * @param  argptr - parameters for format string.
- * @return true if the cache is full, false otherwise.
+ * @return true if successful, false otherwise.
  */
-bool Logger_c::_cacheLine(const char* qualifier, const char* format, va_list argptr)
+bool Logger_c::formatEntry(Entry_t & entry, const char* qualifier, const char* format, va_list argptr)
 {
     char line[LINE_LENGTH];
-    char * p = line;
 
-//- Conditionally add the time stamp.
-    if (timestamp == true)
+//- Add the qualifier.
+    const int length = snprintf(line, LINE_LENGTH, "%s ", qualifier);
+    if (length < 0)
     {
-        p += _getTimestamp(p);
+        return false;
     }
 
-//- Add the qualifier.
-    p += sprintf(p, "%s ", qualifier);
-
 //- Now add the actual log entry.
-    if (vsprintf(p, format, argptr) < 0)
+    const int used = std::min(length, LINE_LENGTH - 1);
+    const bool ret = vsnprintf(line + used, LINE_LENGTH - used, format, argptr) >= 0;
+    entry.line = line;
+
+    return ret;
+}
+
+
+/**
+ * Apply the current options to a generated log entry before caching it.
+ *
+ * @param  entry - the log entry to cache.
+ * @param  module - the module name, used to route the entry to a log file.
+ * @param  stamp - the raw time stamp, formatted when written, 0 for none.
+ */
+void Logger_c::_setEntryOptions(Entry_t & entry, const char* module, unsigned long long stamp) const
+{
+    entry.stamp = stamp;
+
+    if (_isRouted())
+    {
+        size_t length = strlen(module);
+        while ((length) && (module[length-1] == ' '))
+            --length;
+        entry.module.assign(module, length);
+    }
+    else
+    {
+        entry.module.clear();
+    }
+}
+
+
+/**
+ * Generates and caches the log entry.
+ *
+ * @param  shard - the shard to cache the entry in.
+ * @param  module - the module name, used to route the entry to a log file.
+ * @param  qualifier - log entry qualifier, usually module name and log level.
+ * @param  format - the log entry format string.
+ * @param  argptr - parameters for format string.
+ * @return true if the cache is full, false otherwise.
+ */
+bool Logger_c::_cacheLine(Shard_t & shard, const char* module, const char* qualifier, const char* format, va_list argptr)
+{
+    Entry_t & entry = shard.cache[shard.count];
+    if (!formatEntry(entry, qualifier, format, argptr))
     {
-        error = 1;
+        shard.error = 1;
     }
 
 //- Add the new line to the cache and increment the line count.
-    cache[count] = line;
-    ++count;
+    _setEntryOptions(entry, module, _getStamp());
+    ++shard.count;
 
-    return ((count) == (MAX_LINES));
+    return ((shard.count) == (MAX_LINES));
 }
 
 
 /**
- * Put the log entry in the cache. If this fills it, flush the cache.
+ * Put the log entry in the cache of a shard. If this fills it, flush the
+ * cache. If the entry is important enough, flush and sync the cache.
  *
+ * @param  shard - the shard to cache the entry in.
+ * @param  module - the module name, used to route the entry to a log file.
+ * @param  level - the logging level for this log entry.
  * @param  qualifier - log entry qualifier, usually module name and log level.
  * @param  format - the log entry format string.
  * @param  argptr - parameters for format string.
  * @return negative error value or 0 if no errors.
  */
-int Logger_c::_log(const char* qualifier, const char* format, va_list argptr)
+int Logger_c::_log(Shard_t & shard, const char* module, int level, const char* qualifier, const char* format, va_list argptr)
 {
 //- Abort on previous error.
-    if (error)
+    if (shard.error)
     {
         return -2;
     }
 
 //- Cache the log entry then flush the cache if full.
     int ret = 0;
-    if (_cacheLine(qualifier, format, argptr))
+    const bool full = _cacheLine(shard, module, qualifier, format, argptr);
+    if ((syncLevel > 0) && (level <= syncLevel))
+    {
+        ret = _flush(shard);
+        const int err = _sync(shard);
+        if (err)
+        {
+            ret = err;
+        }
+    }
+    else
+    if (full)
+    {
+        ret = _flush(shard);
+    }
+    else
+    if constexpr (!Threading_t::MULTI_THREADED)
+    {
+    //- Without the writer thread, group commit once the window ends.
+        if ((durability == Durability_t::GROUP_COMMIT) && (std::chrono::steady_clock::now() - shard.lastSync >= syncWindow))
+        {
+            ret = _flush(shard);
+        }
+    }
+
+    return ret;
+}
+
+
+
+
+/**
+ * Put a block of generated log entries in the cache of a shard, flushing the
+ * cache as it fills, without releasing the shard so the entries are written
+ * together. The entries share one time stamp so that merging the shard files
+ * keeps them together. If the block is important enough, flush and sync the
+ * cache.
+ *
+ * @param  shard - the shard to cache the entries in.
+ * @param  module - the module name, used to route the entries to a log file.
+ * @param  level - the most important logging level of the log entries.
+ * @param  entries - the log entries, which are consumed.
+ * @return negative error value or 0 if no errors.
+ */
+int Logger_c::_logBatch(Shard_t & shard, const char* module, int level, std::vector<Entry_t> & entries)
+{
+//- Abort on previous error.
+    if (shard.error)
+    {
+        return -2;
+    }
+
+    int ret = 0;
+    const unsigned long long stamp = _getStamp();
+    for (auto & entry : entries)
+    {
+        Entry_t & cached = shard.cache[shard.count];
+        std::swap(cached, entry);
+        _setEntryOptions(cached, module, stamp);
+
+        if (++shard.count == MAX_LINES)
+        {
+            const int err = _flush(shard);
+            if (err)
+            {
+                ret = err;
+            }
+        }
+    }
+    entries.clear();
+
+    if ((syncLevel > 0) && (level <= syncLevel))
     {
-        ret = _flush();
+        const int flushed = _flush(shard);
+        const int err = _sync(shard);
+        if ((flushed) || (err))
+        {
+            ret = err ? err : flushed;
+        }
     }
 
     return ret;
@@ -199,6 +1742,8 @@ int Logger_c::_log(const char* qualifier, const char* format, va_list argptr)
  * and the current log level setting.
  */
 
+thread_local std::string Log_c::context;
+
 /**
  * The only Constructor.
  *
@@ -226,14 +1771,102 @@ int Log_c::logf(int level, const char* format, ...) const
 
     va_list argptr;
     va_start(argptr, format);
-    char qualifier[MODULE_NAME_LEN+10];    // ugly
+    char qualifier[QUALIFIER_LEN];
+    _getQualifier(qualifier, level);
+
+    int ret = Logger_c::getInstance().log(module, level, qualifier, format, argptr);
+
+    va_end(argptr);
+
+    return ret;
+}
 
+
+/**
+ * Build the log entry qualifier. The qualifier is truncated to QUALIFIER_LEN.
+ *
+ * @param  qualifier - buffer to hold the qualifier.
+ * @param  level - the logging level for this log entry.
+ */
+void Log_c::_getQualifier(char * qualifier, int level) const
+{
     //- Use the module name and logging level as qualifier.
-    sprintf(qualifier, "%s L%d -", module, level);
+    const int length = std::min(snprintf(qualifier, QUALIFIER_LEN, "%s L%d -", module, level), QUALIFIER_LEN - 1);
+
+    //- Followed by as much of the already rendered context as fits.
+    const size_t count = std::min(context.size(), static_cast<size_t>(QUALIFIER_LEN - 1 - length));
+    memcpy(qualifier + length, context.data(), count);
+    qualifier[length + count] = '\0';
+}
+
+
+/**
+ * Render the context fields once and add them to the context of the current
+ * thread, they are copied into every log entry made by this thread until
+ * destroyed. The context is truncated to CONTEXT_LEN.
+ *
+ * @param  format - the context fields format string, followed by parameters.
+ */
+Log_c::Context_c::Context_c(const char* format, ...) : previous{context.size()}
+{
+    char fields[CONTEXT_LEN];
 
-    int ret = Logger_c::getInstance().log(qualifier, format, argptr);
+    va_list argptr;
+    va_start(argptr, format);
+    const int length = vsnprintf(fields, CONTEXT_LEN, format, argptr);
+    va_end(argptr);
+
+    const size_t space = CONTEXT_LEN - previous;
+    if ((length > 0) && (space > 1))
+    {
+        context += ' ';
+        context.append(fields, std::min(static_cast<size_t>(length), space - 1));
+    }
+}
+
+
+/**
+ * Compare logging levels and add the entry to the batch if sufficiently
+ * important.
+ *
+ * @param  level - the logging level for this log entry.
+ * @param  format - the log entry format string, followed by parameters.
+ * @return negative error value or 0 if no errors.
+ */
+int Log_c::Batch_c::logf(int level, const char* format, ...)
+{
+    if (level > log.logLevel)
+        return -1;
+
+    va_list argptr;
+    va_start(argptr, format);
+    char qualifier[QUALIFIER_LEN];
+    log._getQualifier(qualifier, level);
+
+    entries.emplace_back();
+    const bool ok = Logger_c::formatEntry(entries.back(), qualifier, format, argptr);
 
     va_end(argptr);
 
+    if (level < this->level)
+        this->level = level;
+
+    return ok ? 0 : -2;
+}
+
+
+/**
+ * Cache all the entries in the batch together, then empty the batch.
+ *
+ * @return negative error value or 0 if no errors.
+ */
+int Log_c::Batch_c::commit(void)
+{
+    if (entries.empty())
+        return 0;
+
+    const int ret = Logger_c::getInstance().log(log.module, level, entries);
+    level = MAX_LOG_LEVEL+1;
+
     return ret;
 }
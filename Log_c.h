@@ -25,12 +25,186 @@
 #define _LOG_C_H__201130_1555__INCLUDED_
 
 #include <stdlib.h>
+#include <time.h>
 #include <string>
 #include <array>
+#include <vector>
+#include <map>
+#include <atomic>
 #include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <concepts>
+#include <functional>
+#include <filesystem>
 
 #include <cstdarg>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "LogRing_c.h"
+
+
+/**
+ * @section Logging policies.
+ *
+ * Compile time policies that select the locking and the time stamp clock, so
+ * that each build only pays for what it uses. The policies are selected with
+ * the following build flags:
+ *
+ *    LOG_SINGLE_THREADED - no locks or atomics, only one thread may log.
+ *    LOG_SPIN_LOCKED - spin locks instead of mutexes, for short waits.
+ *    LOG_NO_TIMESTAMP - time stamps are compiled out.
+ *    LOG_MONOTONIC_TIMESTAMP - time stamps never step back with the wall clock.
+ *    LOG_COARSE_TIMESTAMP - cheaper, lower resolution monotonic time stamps.
+ *    LOG_TSC_TIMESTAMP - time stamp counter, the cheapest to capture.
+ */
+
+class NullMutex_c
+{
+public:
+    void lock(void) {}
+    bool try_lock(void) { return true; }
+    void unlock(void) {}
+};
+
+class SpinLock_c
+{
+public:
+    void lock(void) { while (flag.test_and_set(std::memory_order_acquire)) flag.wait(true, std::memory_order_relaxed); }
+    bool try_lock(void) { return !flag.test_and_set(std::memory_order_acquire); }
+    void unlock(void) { flag.clear(std::memory_order_release); flag.notify_one(); }
+
+private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+struct MultiThreaded_t
+{
+    static const bool MULTI_THREADED{true};
+    using Mutex_t = std::mutex;
+    template<typename T> using Atomic_t = std::atomic<T>;
+};
+
+struct SpinLocked_t
+{
+    static const bool MULTI_THREADED{true};
+    using Mutex_t = SpinLock_c;
+    template<typename T> using Atomic_t = std::atomic<T>;
+};
+
+struct SingleThreaded_t
+{
+    static const bool MULTI_THREADED{false};
+    using Mutex_t = NullMutex_c;
+    template<typename T> using Atomic_t = T;
+};
+
+//- Clocks return a raw reading that is converted to wall clock time when the
+//  entry is written. Uncalibrated clocks read nanoseconds, converted by adding
+//  OFFSET, calibrated clocks read ticks that are periodically calibrated
+//  against the wall clock.
+struct NoClock_t
+{
+    static const bool ENABLED{false};
+    static const bool CALIBRATED{false};
+    static constexpr long long OFFSET{};
+    static unsigned long long now(void) { return 0; }
+};
+
+struct RealtimeClock_t
+{
+    static const bool ENABLED{true};
+    static const bool CALIBRATED{false};
+    static constexpr long long OFFSET{};
+    static unsigned long long now(void) { struct timespec tp; clock_gettime(CLOCK_REALTIME, &tp); return (tp.tv_sec * 1000000000ULL) + tp.tv_nsec; }
+};
+
+//- Monotonic time shifted by the wall clock offset captured at start up.
+struct MonotonicClock_t
+{
+    static const bool ENABLED{true};
+    static const bool CALIBRATED{false};
+    static const long long OFFSET;  // Nanoseconds from monotonic to wall clock time.
+    static unsigned long long now(void) { struct timespec tp; clock_gettime(CLOCK_MONOTONIC, &tp); return (tp.tv_sec * 1000000000ULL) + tp.tv_nsec; }
+};
+
+//- Cheaper, lower resolution (usually a few milliseconds), monotonic time.
+struct CoarseClock_t
+{
+    static const bool ENABLED{true};
+    static const bool CALIBRATED{false};
+    static const long long OFFSET;  // Nanoseconds from monotonic to wall clock time.
+    static unsigned long long now(void) { struct timespec tp; clock_gettime(CLOCK_MONOTONIC_COARSE, &tp); return (tp.tv_sec * 1000000000ULL) + tp.tv_nsec; }
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+//- Time stamp counter ticks, calibrated against the wall clock when written.
+struct TscClock_t
+{
+    static const bool ENABLED{true};
+    static const bool CALIBRATED{true};
+    static constexpr long long OFFSET{};
+    static unsigned long long now(void) { return __rdtsc(); }
+};
+#else
+using TscClock_t = CoarseClock_t;
+#endif
+
+#if defined(LOG_SINGLE_THREADED)
+#define LOG_THREADING_POLICY single
+#elif defined(LOG_SPIN_LOCKED)
+#define LOG_THREADING_POLICY spin
+#else
+#define LOG_THREADING_POLICY mutex
+#endif
+
+#if defined(LOG_NO_TIMESTAMP)
+#define LOG_CLOCK_POLICY none
+#elif defined(LOG_MONOTONIC_TIMESTAMP)
+#define LOG_CLOCK_POLICY monotonic
+#elif defined(LOG_COARSE_TIMESTAMP)
+#define LOG_CLOCK_POLICY coarse
+#elif defined(LOG_TSC_TIMESTAMP)
+#define LOG_CLOCK_POLICY tsc
+#else
+#define LOG_CLOCK_POLICY realtime
+#endif
+
+//- The classes that depend on the policies are declared in an inline namespace
+//  named after them, so code built with different policies fails to link
+//  rather than sharing mismatched class layouts.
+#define LOG_POLICY_NAMESPACE_(T, C) policy_##T##_##C
+#define LOG_POLICY_NAMESPACE(T, C) LOG_POLICY_NAMESPACE_(T, C)
+
+inline namespace LOG_POLICY_NAMESPACE(LOG_THREADING_POLICY, LOG_CLOCK_POLICY)
+{
+
+#if defined(LOG_SINGLE_THREADED)
+using Threading_t = SingleThreaded_t;
+#elif defined(LOG_SPIN_LOCKED)
+using Threading_t = SpinLocked_t;
+#else
+using Threading_t = MultiThreaded_t;
+#endif
+
+#if defined(LOG_NO_TIMESTAMP)
+using Clock_t = NoClock_t;
+#elif defined(LOG_MONOTONIC_TIMESTAMP)
+using Clock_t = MonotonicClock_t;
+#elif defined(LOG_COARSE_TIMESTAMP)
+using Clock_t = CoarseClock_t;
+#elif defined(LOG_TSC_TIMESTAMP)
+using Clock_t = TscClock_t;
+#else
+using Clock_t = RealtimeClock_t;
+#endif
+
 
 /**
  * @section Logging Singleton.
@@ -44,47 +218,225 @@ class Logger_c
 public:
     static const int FILE_NAME_LENGTH{180}; // Maximum length of the path to the log file.
     static const int LINE_LENGTH{512};      // Maximum length of a line.
-    static const int MAX_LINES{256};        // Maximum number of cached lines.
+    static const int MAX_LINES{256};        // Maximum number of cached lines per shard.
+    static const int MAX_SHARDS{64};        // Maximum number of independent shards.
 
 //- Delete the copy constructor and assignement operator.
     Logger_c(const Logger_c &) = delete;
     void operator=(const Logger_c &) = delete;
 
-    static Logger_c & getInstance(void) { static Logger_c instance; return instance; }
+    using Mutex_t = Threading_t::Mutex_t;
+
+//- How written log entries are made durable.
+    enum class Durability_t
+    {
+        NONE,                       // Left to the operating system.
+        GROUP_COMMIT                // Synced once per sync window.
+    };
+
+    struct FlushStats_t
+    {
+        unsigned long long flushes{};   // Number of cache writes.
+        unsigned long long lines{};     // Number of log entries written.
+        unsigned long long bytes{};     // Number of bytes written.
+        unsigned long long writeNanos{};    // Time spent writing.
+        unsigned long long syncs{};     // Number of syncs.
+        unsigned long long syncNanos{}; // Time spent syncing.
+        unsigned long long fallbacks{}; // Direct writes while using shared memory, possibly out of order.
+    };
 
-    int log(const char* qualifier, const char* format, va_list argptr) { std::lock_guard<std::mutex> lock(logMutex); return _log(qualifier, format, argptr); }
-    int flush(void) { std::lock_guard<std::mutex> lock(logMutex); return _flush(); }
+    struct Entry_t
+    {
+        std::string module;         // Module name, only set when routing to module files.
+        std::string line;
+        unsigned long long stamp{}; // Raw time stamp, 0 if none.
+    };
 
-    bool setLogFilePath(const std::string & path) { std::lock_guard<std::mutex> lock(logMutex); return _setLogFilePath(path); }
-    std::string getFullLogFileName(void) const  { std::lock_guard<std::mutex> lock(logMutex); return _getFullLogFileName(); }
-    const std::string & getLogFilePath(void) const { std::lock_guard<std::mutex> lock(logMutex); return logFilePath; }
+    static Logger_c & getInstance(void);
 
-    void enableTimestamp(bool enable) { std::lock_guard<std::mutex> lock(logMutex); timestamp = enable; }
+    static bool formatEntry(Entry_t & entry, const char* qualifier, const char* format, va_list argptr);
+
+    int log(const char* module, int level, const char* qualifier, const char* format, va_list argptr) { Shard_t & shard = _getShard(); std::lock_guard<Mutex_t> lock(shard.logMutex); return _log(shard, module, level, qualifier, format, argptr); }
+    int log(const char* module, int level, std::vector<Entry_t> & entries) { Shard_t & shard = _getShard(); std::lock_guard<Mutex_t> lock(shard.logMutex); return _logBatch(shard, module, level, entries); }
+    int warmUp(void);
+    int sync(void);
+    int flush(void);
+    std::shared_future<int> flushAsync(void);
+    int merge(void);
+
+    bool setLogFilePath(const std::string & path) { AllShardsLock_t lock(*this); _closeAllFiles(); return _setLogFilePath(path); }
+    std::string getFullLogFileName(void) const  { std::lock_guard<Mutex_t> lock(shards[0].logMutex); return _getFullLogFileName(LOG_FILE_STEM, _getSegment()); }
+    std::string getFullLogFileName(const std::string & module) const  { std::lock_guard<Mutex_t> lock(shards[0].logMutex); return _getFullLogFileName(_resolveFileStem(_trim(module)), _getSegment()); }
+    const std::string & getLogFilePath(void) const { std::lock_guard<Mutex_t> lock(shards[0].logMutex); return logFilePath; }
+
+    void enableTimestamp(bool enable) { AllShardsLock_t lock(*this); timestamp = enable; }
+    void enableModuleFiles(bool enable) { AllShardsLock_t lock(*this); moduleFiles = enable; _clearStems(); }
+    bool setModuleFile(const std::string & module, const std::string & name) { AllShardsLock_t lock(*this); return _setModuleFile(module, name); }
+
+    bool setShards(int count);
+    int getShards(void) const { return shardCount; }
+    void enableMerge(bool enable) { AllShardsLock_t lock(*this); mergeShards = enable; }
+
+    void setDurability(Durability_t mode, int window = 100);
+    void setSyncLevel(int level) { AllShardsLock_t lock(*this); syncLevel = level; }
+    FlushStats_t getFlushStats(void) const;
+
+    bool enableSharedMemory(bool enable) { AllShardsLock_t lock(*this); return _enableSharedMemory(enable); }
+    std::string getSharedMemoryName(void) const { return LogRing_c::getDefaultName(); }
 
 private:
+    static constexpr const char * LOG_FILE_STEM{"log"};    // Name stem of the shared log file.
+    static const size_t RING_BACKLOG{LogRing_c::DEFAULT_SIZE / 4};  // Bytes kept for the ring before writing directly.
+    static const int ROLLOVER_LEAD{120};    // Seconds before midnight to create the next days files.
+    static const off_t PREALLOCATE_SIZE{1 << 22};   // Bytes of disk space to reserve beyond the end of log files.
+
+//- Reference point used to convert calibrated raw time stamps.
+    struct Calibration_t
+    {
+        unsigned long long ticks{}; // Raw clock reading.
+        long long nanos{};          // Wall clock time of the raw reading.
+        double rate{};              // Nanoseconds per tick.
+        unsigned long long stamp{}; // Last raw time stamp converted.
+        long long wall{};           // Wall clock time the last raw time stamp was converted to.
+    };
+
+    struct File_t
+    {
+        std::string name;           // Full log file name, empty if not yet known.
+        int fd{-1};                 // Cached handle, -1 if not yet opened.
+        bool dirty{};               // Written since last synced.
+        bool reserved{};            // Disk space is reserved beyond the end of the file.
+        std::string buffer;         // Lines gathered for this file during a flush.
+    };
+
+//- Independent cache and writer, each shard writes to its own file segments.
+    struct Shard_t
+    {
+        mutable Mutex_t logMutex;
+        std::array<Entry_t, MAX_LINES> cache;
+        std::map<std::string, File_t> files;            // Open log files keyed by name stem.
+        mutable std::map<std::string, std::string> stems;   // Resolved module to name stem lookups.
+        int index{};
+        int error{};
+        int count{};                // Current number of cached lines.
+        int fileDay{};              // Day that the cached file handles belong to.
+        int preparedDay{};          // Day that the next days files were created on.
+        std::shared_future<int> pending;    // Latest asynchronous write of the shard.
+        Calibration_t calibration;  // Calibration of the raw time stamps written.
+        std::chrono::steady_clock::time_point lastSync;     // Time the files were last synced.
+        FlushStats_t stats;
+    };
+
+//- Holds the locks of all the shards, or the first count shards, used when
+//  changing shared settings. Asynchronous writes read the settings, so wait
+//  for them to complete.
+    struct AllShardsLock_t
+    {
+        AllShardsLock_t(const Logger_c & logger, int count = MAX_SHARDS) : shards{logger.shards}, count{count} { for (int i = 0; i < count; ++i) shards[i].logMutex.lock(); for (int i = 0; i < count; ++i) _waitPending(shards[i]); }
+        ~AllShardsLock_t(void) { for (int i = 0; i < count; ++i) shards[i].logMutex.unlock(); }
+
+        const std::array<Shard_t, MAX_SHARDS> & shards;
+        const int count;
+    };
+
 //- Hide the default constructor and destructor.
-    Logger_c(void) : error{}, count{}, timestamp{true} {}
-    virtual ~Logger_c(void) { flush(); }
+    Logger_c(void);
+    virtual ~Logger_c(void);
 
-    std::string _getFullLogFileName(void) const;
+    static Logger_c * _createInstance(void);
+    static int _getSlot(void);
+    static int _getDay(void);
+    static std::string _trim(const std::string & module);
+    static std::string _sanitize(const std::string & name);
+    static void _waitPending(const Shard_t & shard) { if (shard.pending.valid()) shard.pending.wait(); }
+    std::string _resolveFileStem(const std::string & module) const;
+    std::string _getFileStem(const Shard_t & shard, const std::string & module) const;
+    std::string _getFullLogFileName(const std::string & stem, int segment = -1, time_t when = 0) const;
     bool _setLogFilePath(const std::string & path);
+    bool _setModuleFile(const std::string & module, const std::string & name);
+    bool _isRouted(void) const { return moduleFiles || !moduleMap.empty(); }
+    int _getSegment(void) const { if ((shardCount == 1) || (mergeShards)) return -1; if constexpr (Threading_t::MULTI_THREADED) return _getSlot() % shardCount; else return 0; }
+    bool _enableSharedMemory(bool enable);
+    bool _push(const std::string & name, const std::string & lines);
+    void _clearStems(void) { for (auto & shard : shards) shard.stems.clear(); }
 
-    int _flush(void);
-    int _getTimestamp(char * p) const;
-    bool _cacheLine(const char* qualifier, const char* format, va_list argptr);
-    int _log(const char* qualifier, const char* format, va_list argptr);
+    void _checkFilePath(void) { std::call_once(checkFilePathSet, [this](){ if (logFilePath.empty()) _setLogFilePath("/logs"); }); }
+    void _checkDay(Shard_t & shard);
+    static bool _preallocate(int fd);
+    static void _trim(int fd);
+    void _setFileName(const Shard_t & shard, const std::string & stem, File_t & file);
+    bool _openFile(const Shard_t & shard, const std::string & stem, File_t & file, bool reserve = false);
+    void _prepareNextDay(Shard_t & shard);
+    Shard_t & _getShard(void) { if constexpr (Threading_t::MULTI_THREADED) return shards[_getSlot() % shardCount]; else return shards[0]; }
+    int _sync(Shard_t & shard);
+    void _closeFiles(Shard_t & shard);
+    void _closeAllFiles(int count = MAX_SHARDS) { for (int i = 0; i < count; ++i) _closeFiles(shards[i]); }
+    int _writeFile(Shard_t & shard, const std::string & stem, File_t & file, bool keep = true);
+    int _writeKept(Shard_t & shard);
+    int _write(Shard_t & shard, const Entry_t * entries, int count);
+    int _flush(Shard_t & shard);
+    int _merge(bool all);
+    static int _mergeSegments(const std::filesystem::path & base, const std::vector<std::filesystem::path> & parts, bool ordered);
+    static void _calibrate(Calibration_t & calibration);
+    static long long _getWallClock(const Calibration_t & calibration, unsigned long long stamp);
+    static int _getTimestamp(char * p, long long nanos);
+    void _writer(void);
+    void _startWriter(void) { if (!writer.joinable()) writer = std::thread{&Logger_c::_writer, this}; }
+    void _stopWriter(void);
+    void _commit(void);
+    bool _cacheLine(Shard_t & shard, const char* module, const char* qualifier, const char* format, va_list argptr);
+    unsigned long long _getStamp(void) const { return (Clock_t::ENABLED && timestamp) ? Clock_t::now() : 0; }
+    void _setEntryOptions(Entry_t & entry, const char* module, unsigned long long stamp) const;
+    int _log(Shard_t & shard, const char* module, int level, const char* qualifier, const char* format, va_list argptr);
+    int _logBatch(Shard_t & shard, const char* module, int level, std::vector<Entry_t> & entries);
 
     std::once_flag checkFilePathSet;
-    mutable std::mutex logMutex;
-    std::array<std::string, MAX_LINES> cache;
+    std::array<Shard_t, MAX_SHARDS> shards;
+    Mutex_t ringMutex;
+    Mutex_t mergeMutex;             // Serializes merging the shard files.
+    std::thread writer;             // Runs the asynchronous writes in order.
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<std::packaged_task<int()>> queue;    // Asynchronous writes waiting to run.
+    std::chrono::milliseconds commitWindow;     // Time between writer group commits, 0 for none.
+    bool stopping;                  // The writer finishes once the queue is empty.
+    LogRing_c ring;                 // Shared memory transport to the collector.
+    std::map<std::string, std::string> moduleMap;   // Explicit module to name stem mapping.
     std::string logFilePath;
-    int error;
-    int count;                      // Current number of cached lines.
+    Threading_t::Atomic_t<int> shardCount;  // Number of shards in use.
+    Threading_t::Atomic_t<int> mergeDay;    // Day that the shard files were last merged.
+    int syncLevel;                  // Entries at or below this level are synced immediately, 0 for none.
+    Durability_t durability;
+    std::chrono::milliseconds syncWindow;   // Minimum time between group commit syncs.
     bool timestamp;
+    bool moduleFiles;               // Route each module to its own log file.
+    Threading_t::Atomic_t<bool> mergeShards;    // Merge the shard files when the day changes.
+
+    static Logger_c * instance;     // Single threaded instance, avoids the static guard.
 
 };
 
 
+/**
+ * Get the logging singleton. Single threaded builds create it on first use
+ * without the thread safe static guard.
+ *
+ * @return the logging singleton.
+ */
+inline Logger_c & Logger_c::getInstance(void)
+{
+    if constexpr (Threading_t::MULTI_THREADED)
+    {
+        static Logger_c instance;
+        return instance;
+    }
+    else
+    {
+        return instance ? *instance : *_createInstance();
+    }
+}
+
+
 /**
  * @section Logging referencer.
  *
@@ -98,13 +450,59 @@ class Log_c
 public:
     static const int MAX_LOG_LEVEL{9};      // Highest logging level supported.
     static const int MODULE_NAME_LEN{20};   // Maximum module name length.
+    static const int CONTEXT_LEN{128};      // Maximum length of the thread context.
+    static const int QUALIFIER_LEN{MODULE_NAME_LEN+10+CONTEXT_LEN};   // Maximum qualifier length.
+
+//- Adds fields to the context of the current thread for its lifetime.
+    class Context_c
+    {
+    public:
+        Context_c(const char* format, ...);
+        ~Context_c(void) { context.resize(previous); }
+
+    //- Delete the copy constructor and assignement operator.
+        Context_c(const Context_c &) = delete;
+        void operator=(const Context_c &) = delete;
+
+    private:
+        size_t previous;            // Context length before the fields were added.
+
+    };
+
+//- Builds a block of log entries that are cached together on commit.
+    class Batch_c
+    {
+    public:
+        Batch_c(const Log_c & owner) : log{owner}, level{MAX_LOG_LEVEL+1} {}
+        ~Batch_c(void) { commit(); }
+
+    //- Delete the copy constructor and assignement operator.
+        Batch_c(const Batch_c &) = delete;
+        void operator=(const Batch_c &) = delete;
+
+        int logf(int level, const char* format, ...);
+        int commit(void);
+        size_t size(void) const { return entries.size(); }
+
+    private:
+        const Log_c & log;
+        std::vector<Logger_c::Entry_t> entries;
+        int level;                  // Most important level in the batch.
+
+    };
 
     Log_c(const char* module, int level = 6);
 
     static bool isLogLevelValid(int level) { return (level >= 0) && (level <= MAX_LOG_LEVEL); }
+    bool isEnabled(int level) const { return level <= logLevel; }
 
     int logf(int level, const char* format, ...) const;
+    Batch_c batch(void) const { return Batch_c{*this}; }
+    static const std::string & getContext(void) { return context; }
+    template<std::invocable F>
+    int logf(int level, F && generator) const;
     int flush(void) const { return Logger_c::getInstance().flush(); }
+    std::shared_future<int> flushAsync(void) const { return Logger_c::getInstance().flushAsync(); }
 
     int getLogLevel(void) const { return logLevel; }
     void setLogLevel(int V) { if (V < 0) logLevel = 0; else logLevel = (V > MAX_LOG_LEVEL) ? MAX_LOG_LEVEL : V; }
@@ -114,11 +512,68 @@ public:
     bool setLogFilePath(const std::string & path) const { return Logger_c::getInstance().setLogFilePath(path); }
     void enableTimestamp(bool enable) const { Logger_c::getInstance().enableTimestamp(enable); }
 
+    std::string getModuleLogFileName(void) const { return Logger_c::getInstance().getFullLogFileName(module); }
+    void enableModuleFiles(bool enable) const { Logger_c::getInstance().enableModuleFiles(enable); }
+    bool setModuleFile(const std::string & name) const { return Logger_c::getInstance().setModuleFile(module, name); }
+
+    bool setShards(int count) const { return Logger_c::getInstance().setShards(count); }
+    void enableMerge(bool enable) const { Logger_c::getInstance().enableMerge(enable); }
+    int merge(void) const { return Logger_c::getInstance().merge(); }
+
+    bool enableSharedMemory(bool enable) const { return Logger_c::getInstance().enableSharedMemory(enable); }
+    std::string getSharedMemoryName(void) const { return Logger_c::getInstance().getSharedMemoryName(); }
+
+    int warmUp(void) const { return Logger_c::getInstance().warmUp(); }
+
+    int sync(void) const { return Logger_c::getInstance().sync(); }
+    void setDurability(Logger_c::Durability_t mode, int window = 100) const { Logger_c::getInstance().setDurability(mode, window); }
+    void setSyncLevel(int level) const { Logger_c::getInstance().setSyncLevel(level); }
+    Logger_c::FlushStats_t getFlushStats(void) const { return Logger_c::getInstance().getFlushStats(); }
+
 
 private:
+    void _getQualifier(char * qualifier, int level) const;
+
+    static thread_local std::string context;    // Rendered context fields of this thread.
+
     char module[MODULE_NAME_LEN+1];
     int logLevel;                   // Current logging level cut off.
 
 };
 
+
+/**
+ * Compare logging levels and only generate and cache the entry if
+ * sufficiently important, so the cost of generating discarded entries is
+ * avoided.
+ *
+ * @param  level - the logging level for this log entry.
+ * @param  generator - returns the log entry text when called.
+ * @return negative error value or 0 if no errors.
+ */
+template<std::invocable F>
+int Log_c::logf(int level, F && generator) const
+{
+    if (!isEnabled(level))
+        return -1;
+
+    const std::string entry{std::invoke(std::forward<F>(generator))};
+
+    return logf(level, "%s", entry.c_str());
+}
+
+
+} // inline namespace LOG_POLICY_NAMESPACE
+
+
+/**
+ * Log an entry only evaluating the format parameters if the logging level of
+ * log is sufficiently important. The log and level are evaluated once.
+ *
+ * @param  log - the Log_c instance to log with.
+ * @param  level - the logging level for this log entry.
+ * @param  ... - the log entry format string, followed by parameters.
+ */
+#define LOGF(log, level, ...) do { const auto & LOGF_log = (log); const int LOGF_level = (level); if (LOGF_log.isEnabled(LOGF_level)) LOGF_log.logf(LOGF_level, __VA_ARGS__); } while (0)
+
 #endif // !defined(_LOG_C_H__201130_1555__INCLUDED_)
@@ -24,10 +24,19 @@
 #if !defined(_TEXTFILE_H__20210503_1300__INCLUDED_)
 #define _TEXTFILE_H__20210503_1300__INCLUDED_
 
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/random.h>
 #include <vector>
 #include <string>
 #include <fstream>
 #include <filesystem>
+#include <type_traits>
+#include <ext/stdio_filebuf.h>
 
 
 /**
@@ -41,6 +50,8 @@ class TextFile
 public:
     using Iterator = std::vector<std::basic_string<T>>::const_iterator;
 
+    static const size_t CHUNK_SIZE{1 << 20};    // Size of the write buffer for wide characters.
+
     TextFile(const std::string & file) : fileName{file} {}
     TextFile(const std::filesystem::path & file) : fileName{file} {}
     virtual ~TextFile(void) {}
@@ -72,9 +83,16 @@ public:
 
     int write(const std::vector<std::basic_string<T>> & other) { setData(other); return write(); }
     int write(void) const;
+    int append(const std::vector<std::basic_string<T>> & other) { setData(other); return append(); }
+    int append(void) const;
     int read(int reserve = 100);
 
 private:
+    int create(std::string & temp) const;
+    int put(int fd) const;
+    static int gather(int fd, struct iovec * iov, int count);
+    static int sync(const std::filesystem::path & directory);
+
     std::filesystem::path fileName;
     std::vector<std::basic_string<T>> data;
 
@@ -105,7 +123,10 @@ bool TextFile<T>::equal(const TextFile & other) const
 
 
 /**
- * @brief Write the buffer to the named file.
+ * @brief Write the buffer to the named file. The data is written to a uniquely
+ * named temporary file and synced, which is then renamed over the named file
+ * and the directory synced, so the named file is never left partially
+ * written, even after a crash.
  * 
  * @tparam T Char type.
  * @return int error value or 0 if no errors.
@@ -113,15 +134,204 @@ bool TextFile<T>::equal(const TextFile & other) const
 template<typename T>
 int TextFile<T>::write(void) const
 {
-    if (std::basic_ofstream<T> os{fileName, std::ios::out})
+    std::string temp;
+    const int fd = create(temp);
+    if (fd < 0)
+        return 1;
+
+//- Keep the permissions of the file being replaced.
+    std::error_code ec;
+    const auto status = std::filesystem::status(fileName, ec);
+    if (std::filesystem::exists(status))
+        fchmod(fd, static_cast<mode_t>(status.permissions()));
+
+    int ret = put(fd);
+    if ((ret == 0) && (fsync(fd) != 0))
+        ret = 1;
+    if ((close(fd) != 0) && (ret == 0))
+        ret = 1;
+
+    if (ret == 0)
+    {
+        std::filesystem::rename(temp, fileName, ec);
+        if (!ec)
+        {
+            const std::filesystem::path directory{fileName.parent_path()};
+            return sync(directory.empty() ? "." : directory);
+        }
+    }
+
+    std::filesystem::remove(temp, ec);
+
+    return 1;
+}
+
+
+/**
+ * @brief Append the buffer to the named file, creating it if necessary, and
+ * sync it so that the appended data is not lost after a crash.
+ * 
+ * @tparam T Char type.
+ * @return int error value or 0 if no errors.
+ */
+template<typename T>
+int TextFile<T>::append(void) const
+{
+    const bool created = !exists();
+    const int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if (fd < 0)
+        return 1;
+
+    int ret = put(fd);
+    if ((ret == 0) && (fsync(fd) != 0))
+        ret = 1;
+    if ((close(fd) != 0) && (ret == 0))
+        ret = 1;
+
+    if ((ret == 0) && (created))
+    {
+        const std::filesystem::path directory{fileName.parent_path()};
+        return sync(directory.empty() ? "." : directory);
+    }
+
+    return ret;
+}
+
+
+/**
+ * @brief Create a uniquely named temporary file next to the named file. Like
+ * mkstemp() the file is created exclusively, but the usual permissions, as
+ * restricted by the umask, are kept.
+ * 
+ * @tparam T Char type.
+ * @param temp set to the name of the temporary file.
+ * @return int file handle or -1 if the file could not be created.
+ */
+template<typename T>
+int TextFile<T>::create(std::string & temp) const
+{
+    static const char characters[]{"0123456789abcdefghijklmnopqrstuvwxyz"};
+
+    for (int attempt = 0; attempt < 100; ++attempt)
+    {
+        unsigned char suffix[6]{static_cast<unsigned char>(attempt)};
+        getrandom(suffix, sizeof(suffix), 0);
+
+        temp = fileName.string() + '.';
+        for (auto c : suffix)
+            temp += characters[c % (sizeof(characters) - 1)];
+
+        const int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if ((fd >= 0) || (errno != EEXIST))
+            return fd;
+    }
+
+    return -1;
+}
+
+
+/**
+ * @brief Flush a directory to the storage device, making renamed and created
+ * files durable.
+ * 
+ * @tparam T Char type.
+ * @param directory the directory to sync.
+ * @return int error value or 0 if no errors.
+ */
+template<typename T>
+int TextFile<T>::sync(const std::filesystem::path & directory)
+{
+    const int fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 1;
+
+    const int ret = fsync(fd);
+    close(fd);
+
+    return ret ? 1 : 0;
+}
+
+
+/**
+ * @brief Write the buffer to the given file handle. Narrow lines are written
+ * straight from the stored strings with vectored writes, wide lines through
+ * a large stream buffer.
+ * 
+ * @tparam T Char type.
+ * @param fd the file handle to write to.
+ * @return int error value or 0 if no errors.
+ */
+template<typename T>
+int TextFile<T>::put(int fd) const
+{
+    if constexpr (std::is_same_v<T, char>)
     {
+        static char newline{'\n'};
+        std::vector<struct iovec> iov;
+        iov.reserve(IOV_MAX);
+
         for (const auto & line : data)
-            os << line << '\n';
+        {
+            if (iov.size() + 2 > IOV_MAX)
+            {
+                if (gather(fd, iov.data(), static_cast<int>(iov.size())))
+                    return 1;
+                iov.clear();
+            }
 
-        return 0;
+            iov.push_back({const_cast<char *>(line.data()), line.size()});
+            iov.push_back({&newline, 1});
+        }
+
+        return gather(fd, iov.data(), static_cast<int>(iov.size()));
     }
+    else
+    {
+        __gnu_cxx::stdio_filebuf<T> buffer{dup(fd), std::ios::out, CHUNK_SIZE};
+        std::basic_ostream<T> os{&buffer};
+        for (const auto & line : data)
+            os << line << T('\n');
+        os.flush();
 
-    return 1;
+        return os ? 0 : 1;
+    }
+}
+
+
+/**
+ * @brief Write all the given buffers to the given file handle, continuing
+ * after partial writes.
+ * 
+ * @tparam T Char type.
+ * @param fd the file handle to write to.
+ * @param iov the buffers to write, which are updated as they are written.
+ * @param count the number of buffers.
+ * @return int error value or 0 if no errors.
+ */
+template<typename T>
+int TextFile<T>::gather(int fd, struct iovec * iov, int count)
+{
+    while (count)
+    {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return 1;
+        }
+
+        for (; (count) && (written >= static_cast<ssize_t>(iov->iov_len)); ++iov, --count)
+            written -= iov->iov_len;
+
+        if (count)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return 0;
 }
 
 
@@ -0,0 +1,318 @@
+/**
+ * @file    logd.cpp
+ * @author  Phil Lockett <phillockett65@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * https://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Local log collector. Drains the shared memory rings of all the logging
+ * processes on the host and writes the log files on their behalf, so that
+ * there is a single writer per host. Only rings owned by the user running
+ * the logging process are accepted, and only log files under the log root
+ * are written. Log files are opened as the user that owns the ring, so a
+ * ring can only write to log files that its user owns.
+ *
+ * Build using:
+ *    g++ -std=c++20 -c -o logd.o logd.cpp
+ *    g++ -std=c++20 -c -o LogRing_c.o LogRing_c.cpp
+ *    g++ -std=c++20 -o logd logd.o LogRing_c.o
+ *
+ * Run using:
+ *    ./logd [log root, default /logs]
+ *
+ */
+
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/fsuid.h>
+#include <iostream>
+#include <filesystem>
+#include <memory>
+#include <map>
+#include <set>
+#include <thread>
+#include <chrono>
+
+#include "LogRing_c.h"
+
+
+/**
+ * @section collector state.
+ */
+
+static const char * SHARED_MEMORY_DIR{"/dev/shm"};
+static const char * DEFAULT_LOG_ROOT{"/logs"};
+static const auto POLL_INTERVAL{std::chrono::milliseconds(10)};
+
+static volatile sig_atomic_t running{1};
+
+static std::map<std::string, std::unique_ptr<LogRing_c>> rings;    // Attached rings keyed by name.
+static std::map<std::pair<uid_t, std::string>, int> files;          // Open log files keyed by user and name.
+static std::set<std::string> rejected;                              // Names of rings that are not trusted.
+static std::filesystem::path root;                                  // Only log files under here are written.
+
+
+/**
+ * @section basic utility code.
+ */
+
+static void stop(int)
+{
+    running = 0;
+}
+
+static bool isOwnerAlive(const LogRing_c & ring)
+{
+    return (kill(ring.getOwner(), 0) == 0) || (errno != ESRCH);
+}
+
+static bool isOwnerTrusted(const LogRing_c & ring)
+{
+    struct stat status;
+    const std::string process = "/proc/" + std::to_string(ring.getOwner());
+    if (stat(process.c_str(), &status) == 0)
+        return status.st_uid == ring.getUid();
+
+//- The owner has finished, so the ring can not be claiming another users process.
+    return errno == ENOENT;
+}
+
+static bool isUnderRoot(const std::filesystem::path & path)
+{
+    const std::filesystem::path relative = path.lexically_relative(root);
+
+    return (!relative.empty()) && (*relative.begin() != "..") && (*relative.begin() != ".");
+}
+
+static void closeFiles(void)
+{
+    for (auto & [name, fd] : files)
+        close(fd);
+
+    files.clear();
+}
+
+
+/**
+ * @section collector code.
+ */
+
+/**
+ * Attach to any new rings created by logging processes. Rings that are not
+ * owned by the user running the logging process that they name are rejected.
+ * Rings of processes that have already finished are accepted, they can only
+ * be drained and removed.
+ */
+static void findRings(void)
+{
+    std::error_code ec;
+    for (const auto & entry : std::filesystem::directory_iterator(SHARED_MEMORY_DIR, ec))
+    {
+        const std::string name = "/" + entry.path().filename().string();
+        if ((!name.starts_with(LogRing_c::NAME_PREFIX)) || (rings.contains(name)) || (rejected.contains(name)))
+            continue;
+
+        auto ring = std::make_unique<LogRing_c>();
+        if (!ring->attach(name))
+            continue;
+
+        if (isOwnerTrusted(*ring))
+            rings[name] = std::move(ring);
+        else
+        {
+            std::cerr << "logd: rejected " << name << '\n';
+            rejected.insert(name);
+        }
+    }
+}
+
+
+/**
+ * Open a log file for appending as the user that owns a ring, creating it and
+ * its directories if necessary. The file system checks are made as that user,
+ * when the collector is privileged, and the log file must belong to the user.
+ *
+ * @param  path - the full log file name.
+ * @param  ring - the ring naming the log file.
+ * @return the file handle or -1 if the log file can not be written.
+ */
+static int openFile(const std::filesystem::path & path, const LogRing_c & ring)
+{
+    setfsuid(ring.getUid());
+    setfsgid(ring.getGid());
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    int fd = -1;
+    bool created = false;
+    if (isUnderRoot(std::filesystem::canonical(path.parent_path(), ec) / path.filename()))
+    {
+        fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC | O_NOFOLLOW);
+        if ((fd < 0) && (errno == ENOENT))
+        {
+            fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC | O_NOFOLLOW, 0644);
+            created = (fd >= 0);
+        }
+    }
+
+    setfsgid(getegid());
+    setfsuid(geteuid());
+
+//- Unprivileged collectors can not switch user, so check who owns the file.
+    struct stat status;
+    if ((fd >= 0) && ((fstat(fd, &status) < 0) || (status.st_uid != ring.getUid())))
+    {
+        if (created)
+            unlink(path.c_str());
+        close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+
+/**
+ * Append lines to a log file, opening the file if necessary. The log file must
+ * be under the log root, including after resolving any links, and belong to
+ * the user that owns the ring.
+ *
+ * @param  name - the full log file name.
+ * @param  lines - the lines to append.
+ * @param  ring - the ring that the lines were taken from.
+ * @return error value or 0 if no errors.
+ */
+static int writeFile(const std::string & name, const std::string & lines, const LogRing_c & ring)
+{
+    const auto key = std::make_pair(ring.getUid(), name);
+    auto it = files.find(key);
+    if (it == files.end())
+    {
+        const std::filesystem::path path{std::filesystem::path{name}.lexically_normal()};
+        if ((!path.is_absolute()) || (!isUnderRoot(path)))
+            return 1;
+
+        const int fd = openFile(path, ring);
+        if (fd < 0)
+            return 1;
+
+        it = files.emplace(key, fd).first;
+    }
+
+    const char * p = lines.data();
+    size_t remaining = lines.size();
+    while (remaining)
+    {
+        const ssize_t written = write(it->second, p, remaining);
+        if (written < 0)
+            return 1;
+
+        p += written;
+        remaining -= written;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Drain all the attached rings, then remove the rings of processes that have
+ * finished and drop any rings found to be corrupt.
+ *
+ * @return the number of records written.
+ */
+static int drainRings(void)
+{
+    int count{};
+    std::string name;
+    std::string lines;
+
+    for (auto it = rings.begin(); it != rings.end(); )
+    {
+        LogRing_c & ring = *it->second;
+        while (ring.pop(name, lines))
+        {
+            if (writeFile(name, lines, ring))
+                std::cerr << "logd: failed to write " << name << '\n';
+            ++count;
+        }
+
+        if (ring.isCorrupt())
+        {
+            std::cerr << "logd: dropped corrupt " << it->first << '\n';
+            rejected.insert(it->first);
+            it = rings.erase(it);
+        }
+        else
+        if ((!isOwnerAlive(ring)) && (ring.isEmpty()))
+        {
+            ring.remove();
+            it = rings.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    return count;
+}
+
+
+/**
+ * Collector entry point.
+ *
+ * @param  argc - command line argument count.
+ * @param  argv - command line argument vector.
+ * @return error value or 0 if no errors.
+ */
+int main(int argc, char *argv[])
+{
+    std::error_code ec;
+    root = std::filesystem::weakly_canonical((argc > 1) ? argv[1] : DEFAULT_LOG_ROOT, ec);
+    if (ec)
+    {
+        std::cerr << "logd: invalid log root\n";
+
+        return 1;
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    auto lastClosed = std::chrono::system_clock::now();
+    while (running)
+    {
+        findRings();
+        if (drainRings() == 0)
+            std::this_thread::sleep_for(POLL_INTERVAL);
+
+    //- Log file names change daily, so periodically release the old ones.
+        const auto now = std::chrono::system_clock::now();
+        if (now - lastClosed > std::chrono::minutes(1))
+        {
+            closeFiles();
+            lastClosed = now;
+        }
+    }
+
+    drainRings();
+    closeFiles();
+
+    return 0;
+}
@@ -38,8 +38,14 @@
 #include <filesystem>
 #include <vector>
 #include <thread>
+#include <algorithm>
+#include <limits>
+
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "Log_c.h"
+#include "LogRing_c.h"
 
 #include "TextFile.h"
 #include "unittest.h"
@@ -80,6 +86,34 @@ static int getFileLength(const std::string & fileName)
     return count;
 }
 
+// Counts the number of lines in a text file containing the given text.
+static int countFileLines(const std::string & fileName, const std::string & text)
+{
+    std::ifstream infile(fileName, std::ifstream::in);
+    if (!infile.is_open())
+        return 0;
+
+    int count = 0;
+    std::string line;
+    while (getline(infile, line))
+    {
+        if (line.find(text) != std::string::npos)
+            count++;
+    }
+
+    return count;
+}
+
+// Gets the disk space allocated to a file beyond what its contents need.
+static long getReservedBytes(const std::string & fileName)
+{
+    struct stat status;
+    if (stat(fileName.c_str(), &status) != 0)
+        return -1;
+
+    return std::max(0L, static_cast<long>(status.st_blocks * 512) - static_cast<long>(status.st_size));
+}
+
 // Checks that all lines in a text file are of the required length.
 static bool checkFileLineLength(const std::string & fileName, int length)
 {
@@ -113,6 +147,7 @@ enum LogLevel {
 };
 
 static Log_c log(__FILE__, ERROR);     // Only log serious messages.
+static const int STAMPED_LENGTH{Clock_t::ENABLED ? 54 : 38};   // Length of worker entries.
 
 
 /**
@@ -318,7 +353,714 @@ UNIT_TEST(test7, "Test a large number of log entries generated by different thre
     std::string currentLogFileName = log.getFullLogFileName();
 
     REQUIRE(getFileLength(currentLogFileName) == (THREADS*ENTRIES*LEVEL))
-    REQUIRE(checkFileLineLength(currentLogFileName, 54) == true)
+    REQUIRE(checkFileLineLength(currentLogFileName, STAMPED_LENGTH) == true)
+
+END_TEST
+
+
+/**
+ * @section test writing and appending text files.
+ */
+
+UNIT_TEST(test8, "Test writing and appending text files.")
+
+//- Initialize test set up.
+    const std::string path = "text";
+    const std::string fileName = path + "/text.txt";
+
+    deleteDirectory(path);
+    std::filesystem::create_directories(path);
+
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000; ++i)
+        lines.push_back("Line " + std::to_string(i));
+
+    TextFile<> out{fileName};
+    REQUIRE(out.write(lines) == 0)
+    REQUIRE(std::distance(std::filesystem::directory_iterator{path}, std::filesystem::directory_iterator{}) == 1)
+
+    TextFile<> in{fileName};
+    in.read(1000);
+    REQUIRE(in.equal(out))
+
+//- New files follow the umask, replaced files keep their permissions.
+    const mode_t mask = umask(0);
+    umask(mask);
+    auto permissions = [&fileName]() { return static_cast<mode_t>(std::filesystem::status(fileName).permissions()); };
+    REQUIRE(permissions() == (0666 & ~mask))
+
+    std::filesystem::permissions(fileName, static_cast<std::filesystem::perms>(0640));
+    REQUIRE(out.write(lines) == 0)
+    REQUIRE(permissions() == 0640)
+
+NEXT_CASE(test9, "Test appending to a text file.")
+
+    REQUIRE(out.append(lines) == 0)
+    REQUIRE(getFileLength(fileName) == 2000)
+
+    REQUIRE(out.write(lines) == 0)
+    REQUIRE(getFileLength(fileName) == 1000)
+
+END_TEST
+
+
+/**
+ * @section test routing log entries to per module log files.
+ */
+
+UNIT_TEST(test10, "Test routing log entries to per module log files.")
+
+//- Initialize test set up.
+    const std::string path = "modules";
+    const int ENTRIES = 1000;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.setLogLevel(NOTICE);
+    log.enableModuleFiles(true);
+
+    Log_c alphaLog("Module/Alpha", NOTICE);
+    Log_c betaLog("Module Beta", NOTICE);
+    for (int i = 0; i < ENTRIES; ++i)
+    {
+        alphaLog.logf(NOTICE, "Alpha entry %d", i);
+        betaLog.logf(NOTICE, "Beta entry %d", i);
+        betaLog.logf(NOTICE, "Beta entry %d", i);
+    }
+    log.flush();
+
+    REQUIRE(alphaLog.getModuleLogFileName() != betaLog.getModuleLogFileName())
+    REQUIRE(getFileLength(alphaLog.getModuleLogFileName()) == ENTRIES)
+    REQUIRE(getFileLength(betaLog.getModuleLogFileName()) == ENTRIES*2)
+    REQUIRE(checkFileExists(log.getFullLogFileName()) == false)
+    REQUIRE(getReservedBytes(betaLog.getModuleLogFileName()) < 4096)
+
+NEXT_CASE(test11, "Test mapping modules to a named log file.")
+
+    REQUIRE(alphaLog.setModuleFile("shared") == true)
+    REQUIRE(betaLog.setModuleFile("shared") == true)
+    REQUIRE(alphaLog.getModuleLogFileName() == betaLog.getModuleLogFileName())
+
+    alphaLog.logf(NOTICE, "Alpha entry");
+    betaLog.logf(NOTICE, "Beta entry");
+    log.flush();
+
+    REQUIRE(getFileLength(alphaLog.getModuleLogFileName()) == 2)
+
+    REQUIRE(alphaLog.setModuleFile("../escape/x") == true)
+    REQUIRE(std::filesystem::path{alphaLog.getModuleLogFileName()}.parent_path() == std::filesystem::path{log.getLogFilePath()})
+
+    log.enableModuleFiles(false);
+    REQUIRE(alphaLog.setModuleFile("") == true)
+    REQUIRE(betaLog.setModuleFile("") == true)
+    REQUIRE(alphaLog.getModuleLogFileName() == log.getFullLogFileName())
+
+END_TEST
+
+
+/**
+ * @section test a large number of log entries generated by different threads using shards.
+ */
+
+// Checks that all lines in a text file are in time stamp order.
+static bool checkFileTimeOrder(const std::string & fileName)
+{
+    if constexpr (!Clock_t::ENABLED)
+        return true;
+
+    TextFile<> entries{fileName};
+    entries.read();
+
+    auto later = [](const std::string & a, const std::string & b) { return a.substr(0, 15) > b.substr(0, 15); };
+    return std::adjacent_find(entries.begin(), entries.end(), later) == entries.end();
+}
+
+UNIT_TEST(test12, "Test a large number of log entries generated by different threads using shards.")
+
+//- Initialize test set up.
+    const std::string path = "shards";
+    const int ENTRIES = 1000;
+    const int THREADS = 10;
+    const int SHARDS = 4;
+    const int LEVEL = NOTICE;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    REQUIRE(log.setShards(SHARDS) == true)
+    log.enableTimestamp(true);
+    log.setLogLevel(LEVEL);
+
+    startWorkers(THREADS, ENTRIES, LEVEL);
+
+//- Without merging, each thread finds the segment that it logs to.
+    log.logf(LEVEL, "Entry %6d", 0);
+    REQUIRE(log.flush() == 0)
+    REQUIRE(log.getFullLogFileName().ends_with(".txt") == true)
+    REQUIRE(checkFileExists(log.getFullLogFileName()) == true)
+
+    log.enableMerge(true);
+    REQUIRE(log.merge() == 0)
+    std::string currentLogFileName = log.getFullLogFileName();
+
+    REQUIRE(getFileLength(currentLogFileName) == (THREADS*ENTRIES*LEVEL) + 1)
+    REQUIRE(checkFileLineLength(currentLogFileName, STAMPED_LENGTH) == true)
+    REQUIRE(checkFileTimeOrder(currentLogFileName) == true)
+    REQUIRE(std::distance(std::filesystem::directory_iterator{path}, std::filesystem::directory_iterator{}) == 1)
+
+//- Merging again appends the new segments, keeping the lines as logged.
+    startWorkers(THREADS, ENTRIES, LEVEL);
+    log.logf(LEVEL, "Carriage\rreturn");
+    REQUIRE(log.merge() == 0)
+    REQUIRE(getFileLength(currentLogFileName) == (2*THREADS*ENTRIES*LEVEL) + 2)
+    REQUIRE(countFileLines(currentLogFileName, "Carriage\rreturn") == 1)
+    REQUIRE(checkFileTimeOrder(currentLogFileName) == true)
+    REQUIRE(std::distance(std::filesystem::directory_iterator{path}, std::filesystem::directory_iterator{}) == 1)
+
+//- Segments left from a previous day are interleaved line by line.
+    std::ofstream{path + "/log-2000-01-01.s00.txt"} << "00:00:01.000000 a\n00:00:03.000000 c\r\n";
+    std::ofstream{path + "/log-2000-01-01.s01.txt"} << "00:00:02.000000 b\n";
+    REQUIRE(log.merge() == 0)
+    std::stringstream merged;
+    merged << std::ifstream{path + "/log-2000-01-01.txt"}.rdbuf();
+    REQUIRE(merged.str() == (Clock_t::ENABLED ? "00:00:01.000000 a\n00:00:02.000000 b\n00:00:03.000000 c\r\n" : "00:00:01.000000 a\n00:00:03.000000 c\r\n00:00:02.000000 b\n"))
+    REQUIRE(std::distance(std::filesystem::directory_iterator{path}, std::filesystem::directory_iterator{}) == 2)
+
+    REQUIRE(log.setShards(0) == false)
+    REQUIRE(log.setShards(1) == true)
+    log.enableMerge(false);
+
+END_TEST
+
+
+/**
+ * @section test writing log entries without blocking the caller.
+ */
+
+UNIT_TEST(test13, "Test writing log entries without blocking the caller.")
+
+//- Initialize test set up.
+    const std::string path = "async";
+    const int ENTRIES = 10000;
+    const int LEVEL = NOTICE;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.enableTimestamp(true);
+    log.setLogLevel(LEVEL);
+
+    auto countThreads = []() { return std::distance(std::filesystem::directory_iterator{"/proc/self/task"}, std::filesystem::directory_iterator{}); };
+    const auto threads = countThreads();
+
+    std::vector<std::shared_future<int>> futures;
+    for (int i = 0; i < ENTRIES; ++i)
+    {
+        log.logf(NOTICE, "Adding log entry %d", i);
+        if ((i % 1000) == 0)
+            futures.push_back(log.flushAsync());
+    }
+    futures.push_back(log.flushAsync());
+
+    REQUIRE(futures.back().get() == 0)
+    std::string currentLogFileName = log.getFullLogFileName();
+    REQUIRE(getFileLength(currentLogFileName) == ENTRIES)
+
+    for (const auto & future : futures)
+        REQUIRE(future.wait_for(std::chrono::seconds::zero()) == std::future_status::ready)
+
+//- All the writes are run by a single writer thread.
+    REQUIRE(countThreads() <= threads + 1)
+
+END_TEST
+
+
+/**
+ * @section test that parameters of discarded log entries are not evaluated.
+ */
+
+UNIT_TEST(test14, "Test that parameters of discarded log entries are not evaluated.")
+
+//- Initialize test set up.
+    const std::string path = "lazy";
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.setLogLevel(ERROR);
+
+    int evaluated{};
+    auto expensive = [&evaluated]() { ++evaluated; return std::string{"expensive"}; };
+
+    for (int loggingLevel = CRITICAL; loggingLevel < MAX; ++loggingLevel)
+        LOGF(log, loggingLevel, "Level %d is %s.", loggingLevel, expensive().c_str());
+
+    REQUIRE(evaluated == ERROR)
+
+    int level = CRITICAL;
+    LOGF(log, level++, "Level is only evaluated once.");
+    REQUIRE(level == CRITICAL + 1)
+
+NEXT_CASE(test15, "Test that discarded log entries are not generated.")
+
+    for (int loggingLevel = CRITICAL; loggingLevel < MAX; ++loggingLevel)
+        log.logf(loggingLevel, expensive);
+
+    REQUIRE(evaluated == ERROR*2)
+
+//- Generated entries longer than a line are truncated.
+    REQUIRE(log.logf(CRITICAL, []() { return std::string(4 * Logger_c::LINE_LENGTH, 'x'); }) == 0)
+
+    log.flush();
+    REQUIRE(getFileLength(log.getFullLogFileName()) == ERROR*2 + 2)
+
+    TextFile<> entries{log.getFullLogFileName()};
+    entries.read();
+    REQUIRE(entries.getData().back().length() == Logger_c::LINE_LENGTH - 1 + (Clock_t::ENABLED ? 16 : 0))
+
+END_TEST
+
+
+/**
+ * @section test passing log entries to the collector through shared memory.
+ */
+
+UNIT_TEST(test16, "Test passing log entries to the collector through shared memory.")
+
+//- Initialize test set up.
+    const std::string path = "shared";
+    const int ENTRIES = 1000;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.setLogLevel(NOTICE);
+    const std::string shared = "/dev/shm" + log.getSharedMemoryName();
+    const auto fallbacks = log.getFlushStats().fallbacks;
+    REQUIRE(log.enableSharedMemory(true) == true)
+
+    for (int i = 0; i < ENTRIES; ++i)
+        log.logf(NOTICE, "Shared entry %d", i);
+    log.flush();
+
+    REQUIRE(checkFileExists(log.getFullLogFileName()) == false)
+
+//- A ring still holding entries is left for the collector and reused.
+    REQUIRE(log.enableSharedMemory(false) == true)
+    REQUIRE(checkFileExists(shared) == true)
+    REQUIRE(log.enableSharedMemory(true) == true)
+
+//- Act as the collector.
+    LogRing_c ring;
+    REQUIRE(ring.attach(log.getSharedMemoryName()) == true)
+    REQUIRE(ring.getOwner() == getpid())
+    REQUIRE(ring.getUid() == geteuid())
+
+    int count{};
+    std::string name;
+    std::string lines;
+    while (ring.pop(name, lines))
+    {
+        REQUIRE(name == std::filesystem::absolute(log.getFullLogFileName()).string())
+        count += std::count(lines.begin(), lines.end(), '\n');
+    }
+    REQUIRE(count == ENTRIES)
+    REQUIRE(ring.isEmpty() == true)
+    REQUIRE(ring.isCorrupt() == false)
+    REQUIRE(log.getFlushStats().fallbacks == fallbacks)
+
+//- Lines kept while the ring is full are written directly when flushing.
+    const int FULL = 100000;
+    for (int i = 0; i < FULL; ++i)
+        log.logf(NOTICE, "Full entry %d", i);
+    log.logf(NOTICE, "Kept entry");
+    REQUIRE(log.flush() == 0)
+    REQUIRE(log.getFlushStats().fallbacks > fallbacks)
+    REQUIRE(countFileLines(log.getFullLogFileName(), "Kept entry") == 1)
+
+    count = 0;
+    while (ring.pop(name, lines))
+        count += std::count(lines.begin(), lines.end(), '\n');
+    REQUIRE(count + getFileLength(log.getFullLogFileName()) == FULL + 1)
+
+//- An empty ring is removed.
+    REQUIRE(log.enableSharedMemory(false) == true)
+    REQUIRE(checkFileExists(shared) == false)
+    REQUIRE(ring.remove() == false)
+
+//- Segments passed to the collector are only merged once it has finished.
+    REQUIRE(log.setShards(2) == true)
+    log.enableMerge(true);
+    REQUIRE(log.enableSharedMemory(true) == true)
+    REQUIRE(ring.attach(log.getSharedMemoryName()) == true)
+
+    for (int i = 0; i < ENTRIES; ++i)
+        log.logf(NOTICE, "Segment entry %d", i);
+    REQUIRE(log.flush() == 0)
+
+    std::string segment;
+    while (ring.pop(name, lines))
+    {
+        segment = name;
+        std::ofstream{name, std::ios::app} << lines;
+    }
+    REQUIRE(log.merge() == 0)
+    REQUIRE(checkFileExists(segment) == true)
+
+    REQUIRE(log.enableSharedMemory(false) == true)
+    REQUIRE(log.merge() == 0)
+    REQUIRE(checkFileExists(segment) == false)
+    REQUIRE(countFileLines(log.getFullLogFileName(), "Segment entry") == ENTRIES)
+
+    REQUIRE(log.setShards(1) == true)
+    log.enableMerge(false);
+
+//- Rings that other users can write to are not trusted.
+    LogRing_c other;
+    const std::string otherName = log.getSharedMemoryName() + ".other";
+    REQUIRE(other.create(otherName, 4096) == true)
+    REQUIRE(chmod(("/dev/shm" + otherName).c_str(), 0666) == 0)
+    REQUIRE(ring.attach(otherName) == false)
+    REQUIRE(other.remove() == true)
+
+END_TEST
+
+
+/**
+ * @section test preparing to log without first use delays.
+ */
+
+UNIT_TEST(test17, "Test preparing to log without first use delays.")
+
+//- Initialize test set up.
+    const std::string path = "warm";
+    const int ENTRIES = 100;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.setLogLevel(NOTICE);
+
+    REQUIRE(log.warmUp() == 0)
+    std::string currentLogFileName = log.getFullLogFileName();
+    REQUIRE(checkFileExists(currentLogFileName) == true)
+    REQUIRE(std::filesystem::file_size(currentLogFileName) == 0)
+
+    for (int i = 0; i < ENTRIES; ++i)
+        log.logf(NOTICE, "Warm entry %d", i);
+    log.flush();
+
+    REQUIRE(getFileLength(currentLogFileName) == ENTRIES)
+
+//- Reserved disk space is released when the log file is closed.
+    REQUIRE(getReservedBytes(currentLogFileName) >= 4096)
+    log.setLogFilePath(path);
+    REQUIRE(getReservedBytes(currentLogFileName) < 4096)
+
+END_TEST
+
+
+/**
+ * @section test making log entries durable.
+ */
+
+UNIT_TEST(test18, "Test group committing log entries.")
+
+//- Initialize test set up.
+    const std::string path = "durable";
+    const int ENTRIES = 1000;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.setLogLevel(NOTICE);
+    log.setDurability(Logger_c::Durability_t::GROUP_COMMIT, 0);
+
+    const Logger_c::FlushStats_t before = log.getFlushStats();
+    for (int i = 0; i < ENTRIES; ++i)
+        log.logf(NOTICE, "Durable entry %d", i);
+    log.flush();
+
+    const Logger_c::FlushStats_t after = log.getFlushStats();
+    REQUIRE(after.lines - before.lines == ENTRIES)
+    REQUIRE(after.syncs > before.syncs)
+    REQUIRE(after.flushes > before.flushes)
+
+NEXT_CASE(test19, "Test syncing important log entries immediately.")
+
+    log.setDurability(Logger_c::Durability_t::NONE);
+    log.setSyncLevel(MAJOR);
+
+    const auto syncs = log.getFlushStats().syncs;
+    log.logf(NOTICE, "Not synced");
+    REQUIRE(log.getFlushStats().syncs == syncs)
+    log.logf(CRITICAL, "Synced");
+    REQUIRE(log.getFlushStats().syncs == syncs + 1)
+    REQUIRE(getFileLength(log.getFullLogFileName()) == ENTRIES + 2)
+
+    log.setSyncLevel(0);
+
+NEXT_CASE(test23, "Test group committing log entries once the window ends.")
+
+    log.setDurability(Logger_c::Durability_t::GROUP_COMMIT, 50);
+
+    const Logger_c::FlushStats_t idle = log.getFlushStats();
+    log.logf(NOTICE, "Committed without a flush");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+//- Single threaded builds commit when next logging.
+    if constexpr (!Threading_t::MULTI_THREADED)
+        log.logf(NOTICE, "Committed when logging");
+
+    REQUIRE(log.getFlushStats().syncs > idle.syncs)
+    REQUIRE(getFileLength(log.getFullLogFileName()) == ENTRIES + (Threading_t::MULTI_THREADED ? 3 : 4))
+
+//- The writer thread must not wait for shards that are waiting for it.
+    if constexpr (Threading_t::MULTI_THREADED)
+    {
+        REQUIRE(log.setShards(Logger_c::MAX_SHARDS) == true)
+        log.setDurability(Logger_c::Durability_t::GROUP_COMMIT, 0);
+        for (int i = 0; i < 500; ++i)
+        {
+            log.logf(NOTICE, "Committed while flushing %d", i);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            log.flushAsync();
+            REQUIRE(log.flush() == 0)
+        }
+        REQUIRE(log.setShards(1) == true)
+    }
+
+    log.setDurability(Logger_c::Durability_t::NONE);
+
+END_TEST
+
+
+/**
+ * @section test logging a block of entries together.
+ */
+
+// Checks that the entries of each batch are adjacent in a text file.
+static bool checkFileBatches(const std::string & fileName)
+{
+    std::ifstream infile(fileName, std::ifstream::in);
+    if (!infile.is_open())
+        return false;
+
+    std::string line;
+    std::string previous;
+    while (getline(infile, line))
+    {
+        const size_t pos = line.find("Batch ");
+        const size_t entry = line.find(" entry ");
+        if ((pos == std::string::npos) || (entry == std::string::npos))
+        {
+            previous.clear();
+            continue;
+        }
+
+        const std::string batch = line.substr(pos, entry - pos);
+        if ((std::stoi(line.substr(entry + 7))) && (batch != previous))
+            return false;
+
+        previous = batch;
+    }
+
+    return true;
+}
+
+static void batchWorker(const int id, const int batches, const int size)
+{
+    for (int b = 0; b < batches; ++b)
+    {
+        auto batch = log.batch();
+        for (int i = 0; i < size; ++i)
+            batch.logf(NOTICE, "Batch %d.%d entry %d", id, b, i);
+    }
+}
+
+static void singleWorker(const int id, const int entries)
+{
+    for (int i = 0; i < entries; ++i)
+        log.logf(NOTICE, "Single %d entry %d", id, i);
+}
+
+UNIT_TEST(test20, "Test logging a block of entries together.")
+
+//- Initialize test set up.
+    const std::string path = "batch";
+    const int THREADS = 4;
+    const int BATCHES = 20;
+    const int SIZE = 300;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.setLogLevel(NOTICE);
+
+    {
+        auto batch = log.batch();
+        REQUIRE(batch.logf(DEBUG, "Batch filtered entry 0") == -1)
+        REQUIRE(batch.size() == 0)
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; ++i)
+        threads.emplace_back(batchWorker, i, BATCHES, SIZE);
+
+    for (auto & thread : threads)
+        thread.join();
+    log.flush();
+
+    std::string currentLogFileName = log.getFullLogFileName();
+    REQUIRE(getFileLength(currentLogFileName) == THREADS*BATCHES*SIZE)
+    REQUIRE(checkFileBatches(currentLogFileName) == true)
+
+NEXT_CASE(test24, "Test merging blocks of entries logged to shards.")
+
+    const int SHARDS = 4;
+    const int SINGLES = 5000;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    REQUIRE(log.setShards(SHARDS) == true)
+    log.enableTimestamp(true);
+
+    threads.clear();
+    for (int i = 0; i < THREADS; ++i)
+    {
+        threads.emplace_back(batchWorker, i, BATCHES, SIZE);
+        threads.emplace_back(singleWorker, i, SINGLES);
+    }
+
+    for (auto & thread : threads)
+        thread.join();
+
+//- Entries from other shards must not be merged into the middle of a batch.
+    log.enableMerge(true);
+    REQUIRE(log.merge() == 0)
+
+    currentLogFileName = log.getFullLogFileName();
+    REQUIRE(getFileLength(currentLogFileName) == THREADS*(BATCHES*SIZE + SINGLES))
+    REQUIRE(checkFileTimeOrder(currentLogFileName) == true)
+    REQUIRE(checkFileBatches(currentLogFileName) == true)
+
+    REQUIRE(log.setShards(1) == true)
+    log.enableMerge(false);
+
+END_TEST
+
+
+/**
+ * @section test attaching thread context to log entries.
+ */
+
+UNIT_TEST(test21, "Test attaching thread context to log entries.")
+
+//- Initialize test set up.
+    const std::string path = "context";
+    const int ENTRIES = 100;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.setLogLevel(NOTICE);
+    REQUIRE(log.getContext().empty() == true)
+
+    {
+        Log_c::Context_c request("request=%d", 42);
+        {
+            Log_c::Context_c session("session=%s", "abc");
+            REQUIRE(log.getContext() == " request=42 session=abc")
+            for (int i = 0; i < ENTRIES; ++i)
+                log.logf(NOTICE, "Context entry %d", i);
+        }
+        log.logf(NOTICE, "Request only entry");
+        REQUIRE(log.getContext() == " request=42")
+
+        std::thread other([]() { log.logf(NOTICE, "Other thread entry"); });
+        other.join();
+    }
+    REQUIRE(log.getContext().empty() == true)
+    log.logf(NOTICE, "No context entry");
+    log.flush();
+
+    std::string currentLogFileName = log.getFullLogFileName();
+    REQUIRE(getFileLength(currentLogFileName) == ENTRIES + 3)
+    REQUIRE(countFileLines(currentLogFileName, "- request=42 session=abc Context entry") == ENTRIES)
+    REQUIRE(countFileLines(currentLogFileName, "- request=42 Request only entry") == 1)
+    REQUIRE(countFileLines(currentLogFileName, "request=") == ENTRIES + 1)
+
+NEXT_CASE(test25, "Test truncating log entries with a long context.")
+
+    const int LEVEL = std::numeric_limits<int>::min();
+    const std::string fields(Log_c::CONTEXT_LEN * 2, 'c');
+    const std::string message(Logger_c::LINE_LENGTH * 2, 'm');
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.enableTimestamp(false);
+
+    {
+        Log_c::Context_c request("request=%s", fields.c_str());
+        REQUIRE(log.getContext().size() == Log_c::CONTEXT_LEN)
+        REQUIRE(log.logf(LEVEL, "%s", message.c_str()) == 0)
+        auto batch = log.batch();
+        REQUIRE(batch.logf(LEVEL, "%s", message.c_str()) == 0)
+    }
+    log.flush();
+
+    currentLogFileName = log.getFullLogFileName();
+    REQUIRE(getFileLength(currentLogFileName) == 2)
+    REQUIRE(checkFileLineLength(currentLogFileName, Logger_c::LINE_LENGTH - 1) == true)
+    REQUIRE(countFileLines(currentLogFileName, " L-2147483648 - request=ccc") == 2)
+    REQUIRE(countFileLines(currentLogFileName, "cc mmm") == 2)
+
+    log.enableTimestamp(true);
+
+END_TEST
+
+
+/**
+ * @section test converting raw time stamps to wall clock time.
+ */
+
+// Gets the local time of day in seconds.
+static double getTimeOfDay(void)
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_REALTIME, &tp);
+    struct tm tim;
+    localtime_r(&tp.tv_sec, &tim);
+
+    return (tim.tm_hour * 3600.0) + (tim.tm_min * 60.0) + tim.tm_sec + (tp.tv_nsec / 1e9);
+}
+
+UNIT_TEST(test22, "Test converting raw time stamps to wall clock time.")
+
+//- Initialize test set up.
+    const std::string path = "stamps";
+    const int ENTRIES = 3;
+
+    deleteDirectory(path);
+    REQUIRE(log.setLogFilePath(path) == true)
+    log.enableTimestamp(true);
+    log.setLogLevel(NOTICE);
+
+    std::vector<double> expected;
+    for (int i = 0; i < ENTRIES; ++i)
+    {
+        expected.push_back(getTimeOfDay());
+        log.logf(NOTICE, "Stamped entry %d", i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    log.flush();
+
+    TextFile<> entries{log.getFullLogFileName()};
+    entries.read();
+    const std::vector<std::string> lines{entries.getData()};
+    REQUIRE(lines.size() == ENTRIES)
+
+    for (size_t i = 0; (i < lines.size()) && (i < expected.size()); ++i)
+    {
+        int hours{}, minutes{};
+        double seconds{};
+        REQUIRE(sscanf(lines[i].c_str(), "%d:%d:%lf", &hours, &minutes, &seconds) == 3)
+
+        const double stamped = (hours * 3600.0) + (minutes * 60.0) + seconds;
+        REQUIRE((stamped > expected[i] - 0.05) && (stamped < expected[i] + 0.05))
+    }
 
 END_TEST
 
@@ -335,7 +1077,38 @@ static int runTests(void)
     RUN_TEST(testDefault)
     RUN_TEST(test0)
     RUN_TEST(test6)
-    RUN_TEST(test7)
+
+//- Single threaded builds only allow one thread to log at a time.
+    if constexpr (Threading_t::MULTI_THREADED)
+    {
+        RUN_TEST(test7)
+    }
+
+    RUN_TEST(test8)
+    RUN_TEST(test10)
+
+    if constexpr (Threading_t::MULTI_THREADED)
+    {
+        RUN_TEST(test12)
+    }
+
+    RUN_TEST(test13)
+    RUN_TEST(test14)
+    RUN_TEST(test16)
+    RUN_TEST(test17)
+    RUN_TEST(test18)
+
+    if constexpr (Threading_t::MULTI_THREADED)
+    {
+        RUN_TEST(test20)
+    }
+
+    RUN_TEST(test21)
+
+    if constexpr (Clock_t::ENABLED)
+    {
+        RUN_TEST(test22)
+    }
 
     const int err{FINISHED};
     OUTPUT_SUMMARY;
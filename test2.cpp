@@ -44,7 +44,7 @@ int remoteFunction(int loggingLevel)
         log.setLogLevel(loggingLevel);
 
     for (int logEntryLevel = 1; logEntryLevel < Log_c::MAX_LOG_LEVEL; ++logEntryLevel)
-        log.logf(logEntryLevel, "Logging level set to %d for remoteFunction(%d).", log.getLogLevel(), loggingLevel);
+        LOGF(log, logEntryLevel, "Logging level set to %d for remoteFunction(%d).", log.getLogLevel(), loggingLevel);
 
     return 0;
 }